@@ -0,0 +1,67 @@
+// HTTP 请求耗时测试：通过 FetchWorker 依次发送多次请求，再并发发送一批，
+// 输出每次请求的 DNS/连接/TLS/首字节耗时，检查连接复用、HTTP/2 和压缩是否生效。
+// 顺序请求中第一次之后的请求没有复用连接时以状态码 1 退出
+//
+// 用法：fetchBench [URL] [次数] [--cacert 证书文件]
+// 默认请求 lrclib；测试本地 HTTPS 服务器时用 --cacert 指定其自签名证书
+#include "../include/fetch_worker.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static void printResponse(const char *label, const FetchWorker::Response &r) {
+  const auto &t = r.timings;
+  printf("%-10s %3ld %6zu B  dns %7.2f  connect %7.2f  tls %7.2f  ttfb %7.2f  "
+         "total %7.2f ms  HTTP/%s%s%s%s\n",
+         label, r.status, r.body.size(), t.dnsMs, t.connectMs, t.tlsMs,
+         t.firstByteMs, t.totalMs, FetchWorker::httpVersionName(t.httpVersion),
+         t.reused ? "  reused" : "",
+         r.result != CURLE_OK ? "  " : "",
+         r.result != CURLE_OK ? curl_easy_strerror(r.result) : "");
+}
+
+int main(int argc, char **argv) {
+  std::string url = "https://lrclib.net/api/search?track_name=yesterday";
+  int count = 5;
+  FetchOptions options;
+  std::vector<const char *> positional;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--cacert") == 0 && i + 1 < argc) {
+      options.caInfo = argv[++i];
+    } else {
+      positional.push_back(argv[i]);
+    }
+  }
+  if (positional.size() > 0) {
+    url = positional[0];
+  }
+  if (positional.size() > 1) {
+    count = std::max(1, atoi(positional[1]));
+  }
+
+  FetchWorker worker(options);
+  printf("URL: %s\n\n顺序请求（第一次建立连接，之后复用）：\n", url.c_str());
+  int reused = 0;
+  for (int i = 0; i < count; ++i) {
+    const std::string label = "#" + std::to_string(i + 1);
+    const auto response = worker.fetch(url).get();
+    printResponse(label.c_str(), response);
+    reused += i > 0 && response.result == CURLE_OK && response.timings.reused;
+  }
+
+  printf("\n并发请求 %d 次：\n", count);
+  std::vector<std::future<FetchWorker::Response>> futures;
+  for (int i = 0; i < count; ++i) {
+    futures.push_back(worker.fetch(url));
+  }
+  for (int i = 0; i < count; ++i) {
+    const std::string label = "#" + std::to_string(i + 1);
+    printResponse(label.c_str(), futures[i].get());
+  }
+
+  printf("\n顺序请求的连接复用：%d/%d\n", reused, count - 1);
+  return reused == count - 1 ? 0 : 1;
+}
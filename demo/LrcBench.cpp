@@ -0,0 +1,169 @@
+// LRC 解析性能测试：对比旧版 timestampToMs（substr + std::stoi）与
+// 新版 scanTimestamp（SWAR，无内存分配）的逐行耗时（ns/line）
+//
+// 用法：lrcBench [歌词文件或目录...]
+// 默认使用歌词缓存目录 ~/.cache/waylyrics 中的真实歌词作为测试语料
+// （lyrics.pack 中各记录的源文本，以及目录中的 .txt/.lrc 文件）
+#include "../include/lyrics_document.h"
+#include "../include/lyrics_pack.h"
+#include "../include/utils.hpp"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// 旧版实现（原样保留用于对比）
+static uint64_t legacyTimestampToMs(const std::string &timestampStr) {
+  size_t start = timestampStr.find('[');
+  size_t end = timestampStr.find(']');
+  if (start == std::string::npos || end == std::string::npos || start >= end) {
+    return 0;
+  }
+  std::string timePart = timestampStr.substr(start + 1, end - start - 1);
+  size_t colonPos = timePart.find(':');
+  size_t dotPos = timePart.find('.');
+  if (colonPos == std::string::npos) {
+    return 0;
+  }
+  std::string minStr = timePart.substr(0, colonPos);
+  if (!std::all_of(minStr.begin(), minStr.end(), ::isdigit)) {
+    return 0;
+  }
+  int minutes = std::stoi(minStr);
+  std::string secStr;
+  std::string centiSecStr = "0";
+  if (dotPos != std::string::npos) {
+    secStr = timePart.substr(colonPos + 1, dotPos - colonPos - 1);
+    centiSecStr = timePart.substr(dotPos + 1);
+  } else {
+    secStr = timePart.substr(colonPos + 1);
+  }
+  if (!std::all_of(secStr.begin(), secStr.end(), ::isdigit)) {
+    return 0;
+  }
+  int seconds = std::stoi(secStr);
+  if (centiSecStr.length() > 2)
+    centiSecStr = centiSecStr.substr(0, 2);
+  if (!std::all_of(centiSecStr.begin(), centiSecStr.end(), ::isdigit)) {
+    return 0;
+  }
+  int centiSeconds = centiSecStr.empty() ? 0 : std::stoi(centiSecStr);
+  uint64_t ms = minutes * 60 * 1000 + seconds * 1000 + centiSeconds * 10;
+  return ms;
+}
+
+// 语料为空时使用的示例歌词
+static const char *sampleLyrics = "[ti:sample]\n"
+                                  "[00:00.00]作词 : 示例\n"
+                                  "[00:12.34]第一句歌词\n"
+                                  "[00:15.678]第二句歌词\n"
+                                  "[00:19.90]The third line of lyrics\n"
+                                  "[01:02.03][02:30.00]副歌\n"
+                                  "[03:45.12]\n";
+
+static void collect(const std::filesystem::path &path,
+                    std::vector<std::string> &corpus) {
+  std::error_code ec;
+  if (std::filesystem::is_directory(path, ec)) {
+    if (std::filesystem::is_regular_file(path / "lyrics.pack", ec)) {
+      LyricsPack pack(path);
+      for (auto &source : pack.sources()) {
+        corpus.push_back(std::move(source));
+      }
+    }
+    for (const auto &entry : std::filesystem::directory_iterator(path, ec)) {
+      auto ext = entry.path().extension();
+      if (entry.is_regular_file() && (ext == ".txt" || ext == ".lrc")) {
+        collect(entry.path(), corpus);
+      }
+    }
+  } else if (std::filesystem::is_regular_file(path, ec)) {
+    std::ifstream file(path, std::ios::binary);
+    corpus.emplace_back(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>{});
+  }
+}
+
+// 运行 fn 多轮直到累计超过 200ms，返回每行耗时（纳秒）
+template <typename Fn>
+static double measure(size_t lineCount, Fn &&fn) {
+  using clock = std::chrono::steady_clock;
+  size_t rounds = 0;
+  auto begin = clock::now();
+  auto elapsed = clock::duration{};
+  do {
+    fn();
+    ++rounds;
+    elapsed = clock::now() - begin;
+  } while (elapsed < std::chrono::milliseconds(200));
+  return std::chrono::duration<double, std::nano>(elapsed).count() /
+         (double(rounds) * double(lineCount));
+}
+
+int main(int argc, char **argv) {
+  std::vector<std::string> corpus;
+  if (argc > 1) {
+    for (int i = 1; i < argc; ++i) {
+      collect(argv[i], corpus);
+    }
+  } else if (const char *home = getenv("HOME")) {
+    collect(std::filesystem::path(home) / ".cache/waylyrics", corpus);
+  }
+  if (corpus.empty()) {
+    printf("未找到歌词语料，使用内置示例歌词\n");
+    corpus.emplace_back(sampleLyrics);
+  }
+
+  // 预先切分行，单独测量时间戳解析
+  std::vector<std::string> lines;
+  for (const auto &doc : corpus) {
+    for (auto &line : split(doc, "\n")) {
+      if (!line.empty()) {
+        lines.push_back(std::move(line));
+      }
+    }
+  }
+  size_t mismatch = 0;
+  for (const auto &line : lines) {
+    uint32_t ms = 0;
+    if (line.size() >= 10 && line[0] == '[' && isDigit(line[1]) &&
+        line.find_first_not_of("0123456789:.", 1) == 9 &&
+        scanTimestamp(line, ms) == 10 && ms != legacyTimestampToMs(line)) {
+      ++mismatch; // 仅比较两者都支持的 [mm:ss.xx]
+    }
+  }
+  printf("语料：%zu 首歌词，%zu 行，[mm:ss.xx] 结果不一致：%zu 行\n",
+         corpus.size(), lines.size(), mismatch);
+
+  volatile uint64_t sink = 0;
+  double legacyStamp = measure(lines.size(), [&] {
+    for (const auto &line : lines)
+      sink = sink + legacyTimestampToMs(line);
+  });
+  double newStamp = measure(lines.size(), [&] {
+    for (const auto &line : lines) {
+      uint32_t ms = 0;
+      scanTimestamp(line, ms);
+      sink = sink + ms;
+    }
+  });
+  // 整篇解析：旧版 split + timestampToMs，新版构建 LyricsDocument
+  double legacyDoc = measure(lines.size(), [&] {
+    for (const auto &doc : corpus)
+      for (const auto &line : split(doc, "\n"))
+        sink = sink + legacyTimestampToMs(line);
+  });
+  double newDoc = measure(lines.size(), [&] {
+    for (const auto &doc : corpus)
+      if (auto parsed = LyricsDocument::parse(doc))
+        sink = sink + parsed->size();
+  });
+
+  printf("%-28s %11s %11s %8s\n", "", "old ns/line", "new ns/line", "speedup");
+  printf("%-28s %11.1f %11.1f %7.1fx\n", "timestamp", legacyStamp, newStamp,
+         legacyStamp / newStamp);
+  printf("%-28s %11.1f %11.1f %7.1fx\n", "document (split/timeline)",
+         legacyDoc, newDoc, legacyDoc / newDoc);
+  return 0;
+}
@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+# 本地 lrclib 模拟服务：用于在不访问 lrclib.net 的情况下检查 /api/get 精确查询、
+# 搜索结果排序（歌名/歌手/时长）以及错误处理。
+#
+# 用法：mock_lrclib.py [端口] [--cert 证书文件 --key 私钥文件]
+# 模块配置中设置 "lrclib_url": "http://127.0.0.1:端口" 即可使用；
+# 也可以作为 fetchBench 的目标（HTTPS 时配合 fetchBench --cacert）。
+#
+# 预置的数据（歌手均为 "A"）：
+#   Exact Song  专辑 Alb, 200 秒   /api/get 直接命中
+#   Fuzzy Song  /api/get 返回 404，/api/search 返回多个候选，
+#               只有 A 演唱、183 秒的记录带时间轴歌词（"right"）
+#   Plain Song  只有纯文本歌词（NoSynced）
+#   Broken Song 返回无法解析的 JSON（网络错误）
+#   Slow Song   延迟 3 秒返回（对冲请求、取消）
+import argparse
+import http.server
+import json
+import ssl
+import time
+import urllib.parse
+
+RECORDS = [
+    {"trackName": "Exact Song", "artistName": "A", "albumName": "Alb",
+     "duration": 200, "syncedLyrics": "[00:03.00]exact"},
+    {"trackName": "Fuzzy Song (Live)", "artistName": "A", "albumName": "Live",
+     "duration": 320, "syncedLyrics": "[00:01.00]live"},
+    {"trackName": "Fuzzy Song", "artistName": "Other", "albumName": "Covers",
+     "duration": 181, "syncedLyrics": "[00:01.00]cover"},
+    {"trackName": "Fuzzy Song", "artistName": "A", "albumName": "Demo",
+     "duration": 180, "plainLyrics": "plain"},
+    {"trackName": "Fuzzy Song", "artistName": "A", "albumName": "Fuzzy",
+     "duration": 183, "syncedLyrics": "[00:01.00]right"},
+    {"trackName": "Plain Song", "artistName": "A", "albumName": "Plain",
+     "duration": 150, "plainLyrics": "plain only"},
+    {"trackName": "Slow Song", "artistName": "A", "albumName": "Slow",
+     "duration": 200, "syncedLyrics": "[00:01.00]slow"},
+]
+# /api/get 能直接查到的歌曲，其余只能通过搜索找到
+INDEXED = {"Exact Song", "Plain Song", "Slow Song"}
+SLOW_SECONDS = 3.0
+
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"  # 保持连接，便于检查连接复用
+
+    def log_message(self, fmt, *args):
+        print("%s %s" % (self.command, self.path), flush=True)
+
+    def do_GET(self):
+        url = urllib.parse.urlparse(self.path)
+        query = {k: v[0] for k, v in urllib.parse.parse_qs(url.query).items()}
+        name = query.get("track_name", query.get("q", ""))
+        if "Slow" in name:
+            time.sleep(SLOW_SECONDS)
+        if "Broken" in name:
+            return self.reply(200, b"{\"trackName\": ")
+        if url.path == "/api/get":
+            # 歌名、歌手和时长（秒）都匹配时才返回，带专辑时专辑也要匹配
+            for r in RECORDS:
+                if (r["trackName"] in INDEXED and r["trackName"] == name
+                        and r["artistName"] == query.get("artist_name")
+                        and r["albumName"] == query.get("album_name", r["albumName"])
+                        and str(r["duration"]) == query.get("duration")):
+                    return self.reply(200, r)
+            return self.reply(404, {"code": 404, "name": "TrackNotFound"})
+        if url.path == "/api/search":
+            words = name.lower().split()
+            artist = query.get("artist_name", "").lower()
+            found = [r for r in RECORDS
+                     if all(w in r["trackName"].lower() for w in words)
+                     and (not artist or artist in r["artistName"].lower())]
+            return self.reply(200, found)
+        self.reply(404, {"code": 404})
+
+    def reply(self, code, body):
+        data = body if isinstance(body, bytes) else json.dumps(body).encode()
+        self.send_response(code)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(data)))
+        self.end_headers()
+        try:
+            self.wfile.write(data)
+        except OSError:
+            pass  # 客户端已取消请求
+
+
+def main():
+    parser = argparse.ArgumentParser(description="mock lrclib server")
+    parser.add_argument("port", nargs="?", type=int, default=18766)
+    parser.add_argument("--cert", help="HTTPS 证书（PEM）")
+    parser.add_argument("--key", help="HTTPS 私钥（PEM）")
+    args = parser.parse_args()
+    server = http.server.ThreadingHTTPServer(("127.0.0.1", args.port), Handler)
+    scheme = "http"
+    if args.cert:
+        context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        context.load_cert_chain(args.cert, args.key)
+        server.socket = context.wrap_socket(server.socket, server_side=True)
+        scheme = "https"
+    print("mock lrclib listening on %s://127.0.0.1:%d" % (scheme, args.port), flush=True)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
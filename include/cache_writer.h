@@ -0,0 +1,41 @@
+#ifndef WAYLYRICS_CACHE_WRITER_H
+#define WAYLYRICS_CACHE_WRITER_H
+
+#include "lyrics_pack.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 缓存包的后台写入线程：获取到的歌词放入有界队列，由单个线程合并成批写入
+// （每批只加一次文件锁、一次追加写入），不再为每次写入创建线程。
+// 析构时写完队列中剩余的歌词再退出
+class CacheWriter {
+public:
+  // capacity：队列上限，队列满时丢弃新的写入（歌词仍在内存 LRU 中，下次会重新获取）；
+  // sync：每批写入后 fdatasync
+  CacheWriter(std::shared_ptr<LyricsPack> pack, size_t capacity = 64,
+              bool sync = false);
+  CacheWriter(const CacheWriter &) = delete;
+  CacheWriter &operator=(const CacheWriter &) = delete;
+  ~CacheWriter();
+
+  // 加入写入队列，队列已满时返回 false；lengthMs 为歌曲时长（0 表示未知）
+  bool enqueue(std::string key, std::shared_ptr<const LyricsDocument> lyrics,
+               LyricsSource source = LyricsSource::Network, int64_t lengthMs = 0);
+
+private:
+  void run(std::stop_token stop);
+
+  std::shared_ptr<LyricsPack> pack_;
+  const size_t capacity_;
+  const bool sync_;
+  std::mutex mutex_;
+  std::condition_variable_any cv_;
+  std::vector<LyricsPack::Write> queue_;
+  std::jthread thread_; // 最后声明：析构时先停止线程
+};
+
+#endif // WAYLYRICS_CACHE_WRITER_H
@@ -0,0 +1,114 @@
+#ifndef WAYLYRICS_FETCH_WORKER_H
+#define WAYLYRICS_FETCH_WORKER_H
+
+#include <atomic>
+#include <chrono>
+#include <curl/curl.h>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// HTTP 请求选项
+struct FetchOptions {
+  long timeoutSeconds = 10; // 单个请求的总超时
+  std::string caInfo;       // CA 证书文件（为空时使用系统证书，测试时指向本地服务器的证书）
+};
+
+// 异步 HTTP 请求线程：所有请求由同一个 curl_multi 句柄驱动
+// （curl_multi_socket_action + epoll，事件触发，不轮询），
+// 调用方线程（D-Bus 事件循环、GTK 主线程）提交请求后立即返回，不会阻塞在网络上。
+// 完成回调在请求线程中执行，应尽快返回（解析、写入队列），不能等待其他请求的结果。
+// 连接复用：easy 句柄用完后放回空闲池，连接池由 multi 句柄持有（保持 keep-alive，
+// HTTPS 上协商 HTTP/2，同一主机的请求多路复用），DNS 缓存和 TLS 会话通过进程内的
+// CURLSH 共享（连接池不共享：共享的连接池会绕过 multi 句柄的多路复用和连接数限制）
+class FetchWorker {
+public:
+  // 请求各阶段完成的时间（毫秒，从请求开始计算；复用连接时 DNS/连接/TLS 接近 0）
+  struct Timings {
+    double dnsMs = 0;       // DNS 解析
+    double connectMs = 0;   // TCP 连接
+    double tlsMs = 0;       // TLS 握手
+    double firstByteMs = 0; // 收到第一个字节（TTFB）
+    double totalMs = 0;
+    long httpVersion = 0;   // CURL_HTTP_VERSION_*
+    bool reused = false;    // 是否复用了已有连接
+  };
+  struct Response {
+    CURLcode result = CURLE_OK; // curl 错误码
+    long status = 0;            // HTTP 状态码（未收到响应时为 0）
+    std::string body;           // 已按 Content-Encoding 解压
+    Timings timings;
+  };
+  using Completion = std::function<void(Response &&)>;
+  // 取消标志：由 cancel() 置位，同一标志可用于多个请求
+  using CancelFlag = std::shared_ptr<std::atomic<bool>>;
+
+  explicit FetchWorker(const FetchOptions &options = {});
+  FetchWorker(const FetchWorker &) = delete;
+  FetchWorker &operator=(const FetchWorker &) = delete;
+  // 停止请求线程；未完成的请求（包括进行中的）以 CURLE_ABORTED_BY_CALLBACK 完成，
+  // 未执行的定时任务被丢弃
+  ~FetchWorker();
+
+  // 提交 GET 请求，完成（成功或失败）后在请求线程中调用 done，每个请求恰好调用一次
+  // （请求线程初始化失败或已停止时直接在调用方线程中以 CURLE_FAILED_INIT 完成）
+  // cancel 置位后，未完成的请求以 CURLE_ABORTED_BY_CALLBACK 完成（仍然调用 done）
+  void submit(std::string url, Completion done, CancelFlag cancel = nullptr);
+  // 提交 GET 请求并返回结果的 future（供可以等待的后台线程使用）
+  std::future<Response> fetch(std::string url);
+  // 置位取消标志并中止使用它的请求（进行中的请求从 multi 句柄移除）
+  void cancel(const CancelFlag &flag);
+  // delay 后在请求线程中执行 task（对冲请求的计时），应尽快返回；
+  // 请求线程停止时未执行的任务被丢弃
+  void schedule(std::chrono::milliseconds delay, std::function<void()> task);
+
+  // 进程内共享的 DNS 缓存和 TLS 会话（带锁，可跨线程使用）
+  static CURLSH *share();
+  // 设置共用的请求选项：共享句柄、keep-alive、HTTP/2、Accept-Encoding、超时
+  static void configure(CURL *easy, const FetchOptions &options);
+  static Timings timingsOf(CURL *easy);
+  static const char *httpVersionName(long version); // "1.1"、"2"、"3"
+
+private:
+  struct Request {
+    CURL *easy = nullptr;
+    std::string url;
+    Response response;
+    Completion done;
+    CancelFlag cancel;
+    bool cancelled() const { return cancel && cancel->load(); }
+  };
+
+  void run(std::stop_token stop);
+  void wake(); // 唤醒请求线程（有新请求或需要退出）
+  void startPending();  // 把新提交的请求加入 multi 句柄，仅在请求线程中调用
+  void finishDone();    // 取出已完成的请求并调用完成回调，仅在请求线程中调用
+  void abortCancelled(); // 中止已取消的请求，仅在请求线程中调用
+  void runTimers();     // 执行到期的定时任务，仅在请求线程中调用
+  void release(CURL *easy); // 放回空闲池，仅在请求线程中调用
+  static int onSocket(CURL *easy, curl_socket_t socket, int what, void *userp,
+                      void *socketp);
+  static int onTimer(CURLM *multi, long timeoutMs, void *userp);
+
+  const FetchOptions options_;
+  CURLM *multi_ = nullptr;
+  int epoll_ = -1;
+  int wake_ = -1; // eventfd
+  // curl 要求的下一次超时处理时间（仅请求线程访问）
+  std::optional<std::chrono::steady_clock::time_point> deadline_;
+  std::unordered_map<CURL *, std::unique_ptr<Request>> active_; // 仅请求线程访问
+  std::vector<CURL *> idle_; // 可复用的 easy 句柄（仅请求线程访问）
+  std::mutex mutex_; // 保护 pending_ 和 timers_
+  std::vector<std::unique_ptr<Request>> pending_;
+  std::multimap<std::chrono::steady_clock::time_point, std::function<void()>> timers_;
+  std::jthread thread_; // 最后声明：其他成员在线程启动前已初始化
+};
+
+#endif // WAYLYRICS_FETCH_WORKER_H
@@ -0,0 +1,51 @@
+#ifndef WAYLYRICS_LRCLIB_H
+#define WAYLYRICS_LRCLIB_H
+
+#include "fetch_worker.h"
+#include "lyrics_document.h"
+#include "lyrics_provider.h"
+#include "negative_cache.h"
+#include "track_key.h"
+#include <memory>
+#include <string>
+#include <string_view>
+
+// lrclib 接口：请求地址的构造、响应的解析和歌词来源（请求由 FetchWorker 发送）。
+// 先用 /api/get 按歌名、歌手、专辑和时长精确匹配（只返回一条记录），
+// 没有结果时再用 /api/search，在本地按歌名/歌手是否一致、时长差和是否有时间轴排序，
+// 不再直接取第一条结果（常常是其他版本）
+
+// /api/get 地址；没有歌手或时长时无法精确匹配，返回空
+std::string lrclibGetUrl(std::string_view baseUrl, const LyricsQuery &query);
+// /api/search 地址；withArtist 为 false 时只按歌名查询
+std::string lrclibSearchUrl(std::string_view baseUrl, const LyricsQuery &query,
+                            bool withArtist);
+// 解析 /api/get 的响应体（单个对象），没有时间轴歌词时返回空，miss 为原因
+std::shared_ptr<const LyricsDocument> parseLrclibGet(std::string_view body,
+                                                     LyricsMiss &miss);
+// 解析 /api/search 的响应体（数组），返回与查询最匹配且有时间轴歌词的结果；
+// 时长与播放器报告的相差超过 toleranceMs 的结果被排除
+std::shared_ptr<const LyricsDocument>
+parseLrclibSearch(std::string_view body, const LyricsQuery &query,
+                  int64_t toleranceMs, LyricsMiss &miss);
+
+// lrclib 歌词来源："lrclib"。精确匹配没有结果时，歌名 + 歌手与只按歌名两个模糊查询
+// 同时发出（HTTP/2 时共用一个连接），优先使用前者的结果
+class LrclibProvider : public LyricsProvider {
+public:
+  LrclibProvider(FetchWorker &worker, std::string baseUrl);
+  void lookup(const LyricsQuery &query, const FetchWorker::CancelFlag &cancel,
+              Callback done) override;
+
+private:
+  void searchTrack(const LyricsQuery &query, const FetchWorker::CancelFlag &cancel,
+                   Callback done);
+  // 发送一次 /api/search 并在本地挑选最匹配的结果
+  void searchLyrics(const LyricsQuery &query, bool withArtist,
+                    const FetchWorker::CancelFlag &cancel, Callback done);
+
+  FetchWorker &worker_;
+  std::string baseUrl_; // 不含末尾的 /
+};
+
+#endif // WAYLYRICS_LRCLIB_H
@@ -0,0 +1,55 @@
+#ifndef WAYLYRICS_LYRICS_BUILDER_H
+#define WAYLYRICS_LYRICS_BUILDER_H
+
+#include "lyrics_document.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 解析过程中的临时表，解析完成后一次性拷贝进文档 arena。
+// 各格式的导入器（LRC、SRT、WebVTT、TTML）都通过 openLine/markWord/
+// appendText/closeLine 逐行写入，显示端只看到同一种时间轴结构
+struct LyricsBuilder {
+  std::string text_;              // 字符串表
+  std::vector<LyricsLine> lines_; // 行表
+  std::vector<LyricsWord> words_; // 字表
+  LyricsText title_{}, artist_{}, album_{};
+  uint32_t lengthMs_ = 0;
+  int32_t offsetMs_ = 0;
+
+  // 识别格式并解析，完成后行表按时间排序
+  void parse(std::string_view content);
+  void foldDuplicates();                          // 相同时间戳的下一行作为副歌词
+  void merge(const LyricsBuilder &translation);   // 线性合并翻译歌词
+  std::shared_ptr<const LyricsDocument> finish() const; // 生成 arena
+
+  // 各格式导入器（lyrics_document.cpp / lyrics_import.cpp）
+  void parseLrc(std::string_view content);
+  void parseCues(std::string_view content); // SRT 与 WebVTT
+  void parseTtml(std::string_view content);
+
+  // 逐行写入：openLine 可连续调用多次（多个时间戳共享同一行文本），
+  // 之后写入的文本和逐字时间戳都属于这一行，closeLine 时去除首尾空白并回填
+  void openLine(uint32_t startMs);
+  void markWord(uint32_t ms); // 从当前文本位置开始一个新的字
+  void appendRaw(std::string_view text) { text_.append(text); }
+  // 写入 XML/WebVTT 文本：解码实体（&amp; 等），连续空白合并为一个空格
+  // （out 中 from 之前的内容不参与合并）
+  static void appendMarkup(std::string &out, size_t from, std::string_view text);
+  void closeLine(std::string_view sub = {});
+  bool lineOpen() const { return lineOpen_; }
+  size_t lineStart() const { return lineStart_; }
+
+  void parseTag(std::string_view key, std::string_view value); // 解析标签行
+  LyricsText appendText(std::string_view text); // 去除首尾空白后写入字符串表
+
+private:
+  bool lineOpen_ = false;
+  size_t lineFirst_ = 0; // 当前行组的第一个行号
+  size_t lineStart_ = 0; // 当前行文本在字符串表中的起始位置
+  size_t wordBegin_ = 0; // 当前行第一个字的下标
+
+  void parseLrcLine(std::string_view line);
+};
+
+#endif // WAYLYRICS_LYRICS_BUILDER_H
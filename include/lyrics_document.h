@@ -0,0 +1,159 @@
+#ifndef WAYLYRICS_LYRICS_DOCUMENT_H
+#define WAYLYRICS_LYRICS_DOCUMENT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// 时间轴中的一行歌词（紧凑存储，文本通过偏移/长度引用字符串表）
+struct LyricsLine {
+  uint32_t startMs;    // 开始时间（毫秒）
+  uint32_t textOffset; // 文本在字符串表中的偏移
+  uint16_t textLength; // 文本长度（字节）
+  uint16_t wordCount;  // 逐字时间戳数量（普通 LRC 为 0）
+  uint32_t wordBegin;  // 第一个字在字表中的下标
+  uint32_t subOffset;  // 副歌词（翻译/音译）在字符串表中的偏移
+  uint32_t subLength;  // 副歌词长度（0 表示没有）
+};
+
+// 逐字时间戳（增强 LRC / A2 格式："<mm:ss.xx>word"）
+// 时间相对所在行的开始时间，同一行文本被多个时间戳复用时也能共享字表
+struct LyricsWord {
+  uint32_t offsetMs;   // 相对行开始时间的偏移（毫秒）
+  uint16_t textOffset; // 文本相对所在行文本的偏移
+  uint16_t textLength; // 文本长度（字节）
+};
+
+// 字符串表中的一段文本
+struct LyricsText {
+  uint32_t offset;
+  uint32_t length;
+};
+
+// 编译后歌词格式的文件标识与版本（布局变化时递增版本号）
+constexpr uint32_t kLyricsMagic = 0x43524c57; // "WLRC"
+constexpr uint16_t kLyricsVersion = 1;
+
+// 文档头：arena 由 [头][行表][字表][字符串表] 依次连续组成，各部分 8 字节对齐。
+// 内存中的 arena 与缓存包（lyrics.pack）中保存的编译数据布局完全相同，可直接 mmap 使用。
+// 所有字段为本机字节序，缓存只在本机使用
+struct LyricsDocumentHeader {
+  uint32_t magic;     // kLyricsMagic
+  uint16_t version;   // kLyricsVersion
+  uint16_t reserved;
+  uint32_t byteSize;  // 整个文档的字节数
+  uint32_t lineCount; // 行数
+  uint32_t wordCount; // 字数
+  uint32_t textSize;  // 字符串表大小（字节）
+  uint32_t lengthMs;  // [length:]
+  int32_t offsetMs;   // [offset:]（已应用到所有行）
+  LyricsText title;   // [ti:]
+  LyricsText artist;  // [ar:]
+  LyricsText album;   // [al:]
+};
+
+// 歌词/字幕格式
+enum class LyricsFormat {
+  Lrc,    // [mm:ss.xx] 歌词（含增强 LRC 逐字时间戳）
+  Srt,    // SubRip 字幕
+  WebVtt, // WebVTT 字幕（支持 <hh:mm:ss.xxx> 逐字时间）
+  Ttml,   // TTML（Apple Music 风格，<span begin=...> 逐字时间）
+};
+
+// 根据开头内容识别格式（只检查前几行/前 1KB），无法识别时按 LRC 处理
+LyricsFormat sniffLyricsFormat(std::string_view content);
+
+// 查找游标：记录上一次命中的行和字，正常播放时只需向前移动
+struct LyricsCursor {
+  size_t index = SIZE_MAX; // 上一次命中的行号（SIZE_MAX 表示无效）
+  size_t word = SIZE_MAX;  // 上一次命中的字（相对所在行）
+  void reset() { index = word = SIZE_MAX; }
+};
+
+// 歌词文档：解析后的时间轴、字表和标签信息存放在一块连续内存（arena）中，
+// 对外只暴露指向 arena 的视图。文档创建后不可修改，通过
+// std::shared_ptr<const LyricsDocument> 在 D-Bus 线程、刷新线程和 GTK 回调之间共享
+class LyricsDocument {
+public:
+  static constexpr size_t npos = SIZE_MAX;
+
+  // 解析歌词，先通过 sniffLyricsFormat 识别格式，没有任何时间戳行时返回 nullptr。
+  // LRC 支持的方言：
+  //   - 时间戳 [mm:ss]、[mm:ss.xx]、[mm:ss.xxx]、[mm:ss:xx]、[h:mm:ss.xxx]
+  //   - 同一行多个时间戳（"[00:12.00][01:30.00]副歌"），展开为多行共享文本
+  //   - 标签行 [ti:]、[ar:]、[al:]、[length:]、[offset:+/-毫秒]
+  //   - 行内逐字时间戳（"<mm:ss.xx>字"），从行文本中剥离后存入字表
+  // SRT/WebVTT 的每条字幕为一行（多行文本以空格连接，字幕间隔处插入空行），
+  // TTML 的每个 <p> 为一行，<span begin> 转为逐字时间戳，翻译/音译 span 作为副歌词。
+  // 所有格式都是单次线性遍历，行文本直接写入字符串表，不产生逐行的 std::string
+  // translation 为可选的翻译/音译歌词（LRC），加载时按时间戳线性合并为各行的副歌词；
+  // 同一歌词中紧邻的相同时间戳行（常见的"原文+译文"写法）也会合并
+  static std::shared_ptr<const LyricsDocument>
+  parse(std::string_view syncedLyrics, std::string_view translation = {});
+
+  // 使用一段已有的编译数据（如 mmap 的内存），owner 负责保持 data 有效；
+  // 数据无效时返回 nullptr
+  static std::shared_ptr<const LyricsDocument>
+  fromImage(std::shared_ptr<const void> owner, const std::byte *data,
+            size_t size);
+  // 重新生成等价的 LRC 文本（增强 LRC 逐字时间戳，副歌词写为相同时间戳的下一行），
+  // parse() 可还原同样的时间轴；编译格式升级后由此重新编译缓存的歌词
+  std::string toLrc() const;
+
+  LyricsDocument(const LyricsDocument &) = delete;
+  LyricsDocument &operator=(const LyricsDocument &) = delete;
+
+  bool empty() const { return header_->lineCount == 0; }
+  size_t size() const { return header_->lineCount; }
+  const LyricsLine &line(size_t index) const { return lines_[index]; }
+  // 获取指定行的文本（已去除时间戳和首尾空白）
+  std::string_view text(size_t index) const;
+  // 获取指定行的副歌词（翻译/音译），没有时为空
+  std::string_view subText(size_t index) const;
+  // 标签行信息（没有对应标签时为空/0）
+  std::string_view title() const { return ref(header_->title); }
+  std::string_view artist() const { return ref(header_->artist); }
+  std::string_view album() const { return ref(header_->album); }
+  uint32_t lengthMs() const { return header_->lengthMs; }
+  int32_t offsetMs() const { return header_->offsetMs; }
+  // 编译数据（arena）及其字节数
+  const std::byte *data() const { return data_; }
+  size_t byteSize() const { return byteSize_; }
+
+  // 查找播放位置 pos 对应的行号：
+  // 正常播放时游标向前移动（均摊 O(1)），跳转/回退后使用二分查找（O(log n)）
+  // 位置早于第一行时返回第 0 行（预览第一句），没有歌词时返回 npos
+  size_t lineAt(uint64_t pos, LyricsCursor &cursor) const;
+
+  // 获取指定行的逐字时间戳（普通 LRC 行为空）
+  const LyricsWord *words(size_t index) const;
+  // 查找行 index 中播放位置 pos 对应的字（相对行的下标）：
+  // 游标随播放向前移动，得到当前行后为常数时间；该行没有逐字时间戳或
+  // 尚未唱到第一个字时返回 npos
+  size_t wordAt(size_t index, uint64_t pos, LyricsCursor &cursor) const;
+
+private:
+  friend struct LyricsBuilder;
+
+  // storage 持有 arena 内存，data 指向 arena 起始位置（调用前已校验）
+  LyricsDocument(std::shared_ptr<const void> storage, const std::byte *data,
+                 size_t size);
+  static bool validate(const std::byte *data, size_t size);
+
+  size_t search(uint64_t pos, size_t first) const; // 二分查找（从 first 开始）
+  std::string_view ref(LyricsText r) const {
+    return std::string_view(text_ + r.offset, r.length);
+  }
+
+  std::shared_ptr<const void> storage_; // arena 所有者（堆内存或 mmap）
+  const std::byte *data_;
+  size_t byteSize_;
+  const LyricsDocumentHeader *header_;
+  const LyricsLine *lines_; // 按 startMs 升序排列的行
+  const LyricsWord *words_; // 所有行的逐字时间戳（按行连续存放）
+  const char *text_;        // 所有文本连续存放的字符串表
+};
+
+#endif // WAYLYRICS_LYRICS_DOCUMENT_H
@@ -0,0 +1,60 @@
+#ifndef WAYLYRICS_LYRICS_LRU_H
+#define WAYLYRICS_LYRICS_LRU_H
+
+#include "lyrics_document.h"
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// 进程内的已解析歌词 LRU：按歌曲标识缓存 LyricsDocument，
+// 切换播放器或重播最近的歌曲时不再访问磁盘/网络。
+// 文档通过 shared_ptr 引用计数，正在显示的文档即使被淘汰也不会被释放；
+// 淘汰时会跳过仍被其他地方持有的文档，使其保持在缓存中
+class LyricsLru {
+public:
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t entries = 0;
+    size_t bytes = 0;  // 已缓存文档的总字节数
+    size_t budget = 0; // 字节预算
+  };
+
+  explicit LyricsLru(size_t budgetBytes) : budget_(budgetBytes) {}
+  LyricsLru(const LyricsLru &) = delete;
+  LyricsLru &operator=(const LyricsLru &) = delete;
+
+  // 进程内共享的实例（同一个 waybar 进程中的多个模块共用）
+  static LyricsLru &shared();
+
+  std::shared_ptr<const LyricsDocument> get(const std::string &key);
+  void put(const std::string &key, std::shared_ptr<const LyricsDocument> lyrics);
+  // 各模块按自己的配置申请预算：共享实例只有一个预算，取所有申请中的最大值
+  // （第一次申请替换默认预算），不会被后创建的模块调小
+  void requestBudget(size_t budgetBytes);
+  Stats stats() const;
+  void logStats() const; // 输出统计信息到日志
+
+private:
+  struct Entry {
+    std::string key;
+    std::shared_ptr<const LyricsDocument> lyrics;
+    size_t bytes;
+  };
+  void evict(); // 淘汰最久未使用的条目直到不超过预算，调用方持有 mutex_
+  static size_t costOf(const std::string &key, const LyricsDocument &lyrics);
+
+  mutable std::mutex mutex_;
+  std::list<Entry> entries_; // 头部为最近使用
+  std::unordered_map<std::string, std::list<Entry>::iterator> map_;
+  size_t budget_;
+  bool budgetRequested_ = false; // 是否已有模块申请过预算
+  size_t bytes_ = 0;
+  uint64_t hits_ = 0, misses_ = 0, evictions_ = 0;
+};
+
+#endif // WAYLYRICS_LYRICS_LRU_H
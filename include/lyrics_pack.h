@@ -0,0 +1,141 @@
+#ifndef WAYLYRICS_LYRICS_PACK_H
+#define WAYLYRICS_LYRICS_PACK_H
+
+#include "lyrics_document.h"
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// 歌词来源（记录在 RecordHeader::flags 中）：播放器提供的歌词优先级最高，
+// 写入时不会被其他来源的结果覆盖
+enum class LyricsSource : uint8_t {
+  Network = 0, // 网络查询（lrclib）
+  Import = 1,  // 从旧版 .txt 缓存导入
+  Player = 2,  // 播放器通过 xesam:asText 提供
+};
+
+// 歌词缓存包：所有歌词的编译数据追加写入同一个文件（lyrics.pack），
+// 通过磁盘上的开放寻址哈希索引（lyrics.idx）查找。
+// 两个文件都以 mmap 方式读取，命中时只需一次索引探测，返回的文档直接引用
+// pack 的映射内存，不产生系统调用和拷贝。
+// 写入由 flock（lyrics.lock）保护，多个 waybar 进程可以共享同一个缓存目录
+class LyricsPack {
+public:
+  struct Write {
+    std::string key;
+    std::shared_ptr<const LyricsDocument> lyrics;
+    LyricsSource source = LyricsSource::Network;
+    int64_t lengthMs = 0; // 歌曲时长（毫秒），0 表示未知
+  };
+  struct RecordInfo {
+    int64_t storedAt = 0; // 写入时间（Unix 秒）
+    LyricsSource source = LyricsSource::Network;
+    int64_t lengthMs = 0; // 写入时的歌曲时长（毫秒，精确到秒），0 表示未知
+  };
+  struct Stats {
+    uint64_t packBytes = 0;  // lyrics.pack 大小
+    uint64_t indexBytes = 0; // lyrics.idx 大小
+    size_t entries = 0;      // 索引中的记录数
+    uint64_t compactions = 0;
+    double lastCompactionMs = 0; // 上次压缩耗时
+    size_t lastEvicted = 0;      // 上次压缩淘汰的记录数
+    uint64_t lastReclaimed = 0;  // 上次压缩回收的字节数
+  };
+
+  explicit LyricsPack(const std::filesystem::path &dir);
+  ~LyricsPack();
+
+  LyricsPack(const LyricsPack &) = delete;
+  LyricsPack &operator=(const LyricsPack &) = delete;
+
+  // 查找歌词，未命中时返回 nullptr
+  // info 不为空时返回记录的写入时间和来源
+  std::shared_ptr<const LyricsDocument> find(std::string_view key,
+                                             RecordInfo *info = nullptr);
+  // 追加写入歌词（相同 key 的旧记录被新记录覆盖，除非旧记录的来源优先级更高），
+  // 失败返回 false。记录同时保存源文本（sourceText 为空时由 lyrics 重新生成 LRC），
+  // 编译格式升级后从源文本重新编译
+  bool insert(std::string_view key, const LyricsDocument &lyrics,
+              LyricsSource source = LyricsSource::Network,
+              std::string_view sourceText = {});
+  // 批量写入：只加一次锁、一次追加写入；sync 为 true 时在发布索引前后各 fdatasync 一次
+  bool insert(const std::vector<Write> &batch, bool sync = false);
+  // 内容不变时（后台刷新得到相同的歌词）把记录的写入时间原地更新为当前时间，
+  // 不追加新记录；没有该 key 的记录时返回 false
+  bool touch(std::string_view key);
+  // 导入旧版缓存目录中每个查询一个的 .txt 文件，导入后删除原文件
+  // （原文作为记录的源文本保留在 pack 中）；返回导入的文件数
+  size_t migrate(const std::filesystem::path &dir, std::stop_token stop = {});
+  // 索引中的记录数
+  size_t size();
+  // 索引中所有记录的 key（用于重建模糊匹配索引）
+  std::vector<std::string> keys();
+  // 索引中所有记录的源文本（歌词解析性能测试的语料）
+  std::vector<std::string> sources();
+  // 压缩：丢弃被覆盖的旧记录；maxBytes 不为 0 且超出时按最近访问时间淘汰，
+  // 保留最近访问的记录直到不超过预算的 90%。
+  // 重写到临时文件后 rename 替换，期间只阻塞写入，不阻塞查找。
+  // 不需要压缩或被 stop 中断时返回 false
+  bool compact(uint64_t maxBytes, std::stop_token stop = {});
+  Stats stats();
+  void logStats();
+
+private:
+  // 索引被其他进程重建（rename 替换）后重新映射，调用方持有 mutex_
+  bool refreshIndex();
+  bool mapPack(); // 重新映射 pack（其他进程追加了新记录或压缩后替换了文件）
+  // 已映射的 pack 与索引属于同一次压缩的结果（必要时重新映射 pack），调用方持有 mutex_
+  bool sameGeneration();
+  void saveHits(); // accessed_ 中的命中时间移入 pendingHits_，调用方持有 mutex_
+  // 依次访问索引引用的有效记录（RecordView），调用方持有 mutex_ 并已映射索引
+  template <typename Fn> void forEachRecord(Fn &&fn);
+  std::shared_ptr<const LyricsDocument> lookup(std::string_view key,
+                                               uint64_t hash,
+                                               RecordInfo *info);
+  std::shared_ptr<const LyricsDocument> readRecord(uint64_t offset,
+                                                   std::string_view key,
+                                                   uint64_t hash,
+                                                   RecordInfo *info);
+  struct PendingRecord {
+    std::string_view key;
+    uint64_t hash;
+    const LyricsDocument *lyrics;
+    LyricsSource source;
+    std::string_view sourceText;
+    int64_t lengthMs;
+  };
+  bool insertBatch(std::span<const PendingRecord> records, bool sync);
+  bool insertLocked(std::span<const PendingRecord> records,
+                    bool sync); // 调用方持有文件锁
+  bool compactLocked(uint64_t maxBytes, std::stop_token stop,
+                     Stats &result); // 调用方持有文件锁
+  bool touchLocked(std::string_view key); // 调用方持有文件锁
+  // 持有 lyrics.lock 的排他锁调用 fn，无法加锁时返回 false
+  template <typename Fn> bool withFileLock(Fn &&fn);
+  void flushAccessLog(); // 本进程的命中时间追加到 lyrics.hits
+
+  std::filesystem::path packPath_, indexPath_, lockPath_, hitsPath_;
+  std::mutex mutex_;                   // 保护以下映射状态
+  std::shared_ptr<const void> index_;  // 索引文件映射
+  uint64_t indexInode_ = 0;            // 已映射索引文件的 inode
+  uint32_t indexCapacity_ = 0;         // 槽数（2 的幂）
+  uint64_t indexGeneration_ = 0;       // 已映射索引的压缩代数
+  std::shared_ptr<const void> pack_;   // pack 文件映射（文档直接引用）
+  size_t packSize_ = 0;                // 已映射的字节数
+  uint64_t packInode_ = 0;             // 已映射 pack 文件的 inode
+  uint64_t packGeneration_ = 0;        // 已映射 pack 的压缩代数
+  // 命中时间（Unix 秒，淘汰依据）：与已映射索引的槽一一对应，映射索引时分配，
+  // 命中时只写入对应的元素；压缩前与 pendingHits_ 一起追加到 lyrics.hits
+  std::vector<uint32_t> accessed_;
+  std::vector<std::pair<uint64_t, int64_t>> pendingHits_; // 已替换的索引中的命中（keyHash, 时间）
+  Stats lastCompaction_;                                  // 上次压缩的统计
+};
+
+#endif // WAYLYRICS_LYRICS_PACK_H
@@ -0,0 +1,144 @@
+#ifndef WAYLYRICS_LYRICS_PROVIDER_H
+#define WAYLYRICS_LYRICS_PROVIDER_H
+
+#include "fetch_worker.h"
+#include "lyrics_document.h"
+#include "negative_cache.h"
+#include "track_key.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+// 候选歌词与播放器报告的时长允许的误差（毫秒）
+constexpr int64_t kLengthTolerance = 10000;
+
+// 歌词来源的能力（按位组合）
+enum ProviderCapability : uint32_t {
+  kProviderLocal = 1u << 0,       // 本地来源：不访问网络，在调用线程中同步返回
+  kProviderSynced = 1u << 1,      // 提供时间轴歌词
+  kProviderTranslation = 1u << 2, // 提供翻译歌词（合并为副歌词）
+};
+
+// 歌词来源的描述
+struct ProviderInfo {
+  std::string name;          // 配置中使用的名称
+  uint32_t capabilities = 0; // ProviderCapability
+  int cost = 0;              // 每次查询的 HTTP 请求数（本地来源为 0）
+  std::chrono::milliseconds expectedLatency{0}; // 还没有测量数据时使用的预期延迟
+};
+
+// 歌词来源：播放器自带的歌词、本地缓存、lrclib、网易云音乐等
+class LyricsProvider {
+public:
+  using Callback =
+      std::function<void(std::shared_ptr<const LyricsDocument>, LyricsMiss)>;
+
+  explicit LyricsProvider(ProviderInfo info) : info_(std::move(info)) {}
+  virtual ~LyricsProvider() = default;
+  LyricsProvider(const LyricsProvider &) = delete;
+  LyricsProvider &operator=(const LyricsProvider &) = delete;
+
+  const ProviderInfo &info() const { return info_; }
+  bool isLocal() const { return info_.capabilities & kProviderLocal; }
+
+  // 查询一首歌的歌词，完成时调用 done 恰好一次（没有结果时 miss 为原因）。
+  // 本地来源在调用线程中同步调用 done，远程来源在请求线程中调用；
+  // cancel 置位后不再发出后续请求，进行中的请求由 FetchWorker 中止
+  virtual void lookup(const LyricsQuery &query, const FetchWorker::CancelFlag &cancel,
+                      Callback done) = 0;
+
+private:
+  ProviderInfo info_;
+};
+
+// 以函数实现的本地来源（播放器、缓存）
+class LocalProvider : public LyricsProvider {
+public:
+  using Lookup = std::function<std::shared_ptr<const LyricsDocument>(const LyricsQuery &)>;
+
+  LocalProvider(std::string name, Lookup lookup);
+  void lookup(const LyricsQuery &query, const FetchWorker::CancelFlag &cancel,
+              Callback done) override;
+
+private:
+  Lookup lookup_;
+};
+
+// 检查远程来源的 HTTP 结果，失败时返回 false，miss 为失败原因（404 视为没有结果）
+bool checkLyricsResponse(const FetchWorker::Response &response, LyricsMiss &miss);
+
+// 候选结果与查询的匹配程度（越小越好）：歌名不一致、歌手不一致、时长差（毫秒）
+using MatchRank = std::tuple<bool, bool, int64_t>;
+// 计算候选结果的匹配程度；durationMs <= 0 表示未知，
+// 时长差超过 toleranceMs 时返回 false（现场、混音等其他版本）
+bool rankCandidate(const LyricsQuery &query, std::string_view title,
+                   std::string_view artist, int64_t durationMs, int64_t toleranceMs,
+                   MatchRank &rank);
+
+// 最近若干次查询的耗时，用于计算对冲请求的等待时间
+class LatencyTracker {
+public:
+  static constexpr size_t kWindow = 64;    // 保留的样本数
+  static constexpr size_t kMinSamples = 8; // 样本不足时使用预期延迟
+
+  void record(std::chrono::microseconds latency);
+  // 第 percent 百分位的耗时，样本不足时返回 fallback
+  std::chrono::microseconds percentile(int percent, std::chrono::microseconds fallback) const;
+  size_t count() const; // 累计样本数
+
+private:
+  mutable std::mutex mutex_;
+  std::vector<int64_t> samples_; // 环形缓冲（微秒）
+  size_t next_ = 0;
+  size_t total_ = 0;
+};
+
+// 按配置顺序组合歌词来源：先依次查询本地来源，都没有时对远程来源发出对冲请求
+// （前一个来源在其 p95 耗时内没有返回时启动下一个，前一个没有结果时立即启动下一个），
+// 使用第一个有效的时间轴歌词并取消其余请求
+class LyricsResolver {
+public:
+  LyricsResolver(FetchWorker &worker,
+                 std::vector<std::unique_ptr<LyricsProvider>> providers);
+  LyricsResolver(const LyricsResolver &) = delete;
+  LyricsResolver &operator=(const LyricsResolver &) = delete;
+
+  // 依次查询本地来源（同步），返回第一个结果
+  std::shared_ptr<const LyricsDocument> resolveLocal(const LyricsQuery &query);
+  // 查询远程来源，完成时在请求线程中调用 done 恰好一次；
+  // 都没有结果时 miss 取有效期最短的原因（网络错误 < 无时间轴 < 无结果）
+  void resolveRemote(const LyricsQuery &query, LyricsProvider::Callback done);
+
+  bool enabled(std::string_view name) const;
+  bool hasRemote() const { return !remote_.empty(); }
+  std::string names() const; // "player,cache,lrclib"
+  void logStats() const;     // 输出各来源的命中数和耗时
+
+private:
+  struct Entry {
+    std::unique_ptr<LyricsProvider> provider;
+    LatencyTracker latency;
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+  };
+  struct Race; // 一次远程查询的状态
+
+  // 启动下一个远程来源（持有 race 的锁调用，启动前释放）
+  void launchNext(const std::shared_ptr<Race> &race, std::unique_lock<std::mutex> &lock);
+  void onResult(const std::shared_ptr<Race> &race, size_t index,
+                std::chrono::steady_clock::time_point start,
+                std::shared_ptr<const LyricsDocument> lyrics, LyricsMiss miss);
+
+  FetchWorker &worker_;
+  std::vector<std::unique_ptr<Entry>> local_;  // 配置顺序
+  std::vector<std::unique_ptr<Entry>> remote_; // 配置顺序
+};
+
+#endif // WAYLYRICS_LYRICS_PROVIDER_H
@@ -0,0 +1,62 @@
+#ifndef WAYLYRICS_NEGATIVE_CACHE_H
+#define WAYLYRICS_NEGATIVE_CACHE_H
+
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <mutex>
+#include <string_view>
+#include <sys/types.h>
+#include <unordered_map>
+
+// 歌词获取失败的原因，决定负缓存的有效期
+enum class LyricsMiss : uint8_t {
+  NotFound,     // 查询结果为空（7 天）
+  NoSynced,     // 只有纯文本歌词，没有时间轴（3 天）
+  NetworkError, // 网络/HTTP 错误（5 分钟）
+};
+
+// 持久化的负缓存：记录已知没有歌词的歌曲，有效期内不再发起网络请求。
+// 内存中只保存 key 的 64 位哈希（哈希表，O(1) 查询）；
+// 磁盘文件 lyrics.miss 为追加写入的定长记录，启动时加载并丢弃过期记录。
+// 多个进程可以共享同一个文件：追加和重写都持有 lyrics.miss.lock 的排他锁（flock）；
+// 查询和追加前读取其他进程追加的记录，文件被其他进程重写（替换）时重新加载
+class NegativeCache {
+public:
+  explicit NegativeCache(const std::filesystem::path &dir);
+  NegativeCache(const NegativeCache &) = delete;
+  NegativeCache &operator=(const NegativeCache &) = delete;
+  ~NegativeCache();
+
+  // key 在有效期内被记录为缺失时返回 true，reason 可为空
+  bool contains(std::string_view key, LyricsMiss *reason = nullptr);
+  void record(std::string_view key, LyricsMiss reason);
+  void erase(std::string_view key); // 后来获得了歌词（例如播放器提供）
+  size_t size() const;
+
+  static std::time_t ttlOf(LyricsMiss reason);
+
+private:
+  struct Entry {
+    int64_t expiresAt; // Unix 秒
+    LyricsMiss reason;
+  };
+  // 以下调用方持有 mutex_；load/compact 还需持有文件锁
+  void load();
+  void compact(); // 重写文件，只保留未过期的记录
+  void append(uint64_t keyHash, const Entry &entry);
+  void refresh(); // 文件有变化时读取新记录
+  // 读取文件中还没有读过的记录（文件被替换时从头读取），返回记录数，文件无效时返回 -1
+  ssize_t readLog();
+
+  std::filesystem::path path_;
+  std::filesystem::path lockPath_;
+  mutable std::mutex mutex_;
+  std::unordered_map<uint64_t, Entry> entries_;
+  uint64_t fileDev_ = 0, fileIno_ = 0; // 已读取的文件
+  int64_t readSize_ = 0;               // 已读取到的位置（字节）
+  int fd_ = -1;     // O_APPEND 打开的 lyrics.miss
+  int lockFd_ = -1; // lyrics.miss.lock，打开失败时不做跨进程互斥
+};
+
+#endif // WAYLYRICS_NEGATIVE_CACHE_H
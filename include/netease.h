@@ -0,0 +1,40 @@
+#ifndef WAYLYRICS_NETEASE_H
+#define WAYLYRICS_NETEASE_H
+
+#include "fetch_worker.h"
+#include "lyrics_document.h"
+#include "lyrics_provider.h"
+#include "negative_cache.h"
+#include "track_key.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// 网易云音乐接口：先搜索歌曲（按歌名/歌手是否一致和时长差挑选），再按歌曲 id 获取歌词，
+// 翻译歌词（tlyric）合并为副歌词
+
+// 搜索地址（歌名 + 歌手作为关键词）
+std::string neteaseSearchUrl(std::string_view baseUrl, const LyricsQuery &query);
+// 歌词地址
+std::string neteaseLyricUrl(std::string_view baseUrl, int64_t songId);
+// 解析搜索结果，返回最匹配的歌曲 id，没有时返回 0，miss 为原因
+int64_t parseNeteaseSearch(std::string_view body, const LyricsQuery &query,
+                           int64_t toleranceMs, LyricsMiss &miss);
+// 解析歌词响应，没有时间轴歌词时返回空，miss 为原因
+std::shared_ptr<const LyricsDocument> parseNeteaseLyric(std::string_view body,
+                                                        LyricsMiss &miss);
+
+// 网易云音乐歌词来源："netease"
+class NeteaseProvider : public LyricsProvider {
+public:
+  NeteaseProvider(FetchWorker &worker, std::string baseUrl);
+  void lookup(const LyricsQuery &query, const FetchWorker::CancelFlag &cancel,
+              Callback done) override;
+
+private:
+  FetchWorker &worker_;
+  std::string baseUrl_; // 不含末尾的 /
+};
+
+#endif // WAYLYRICS_NETEASE_H
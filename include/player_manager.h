@@ -1,6 +1,8 @@
 #ifndef WAYLYRICS_PLAYER_MANAGER_H
 #define WAYLYRICS_PLAYER_MANAGER_H
 
+#include "lyrics_document.h"
+#include <atomic>
 #include <cstdint>
 #include <functional>
 #include <memory>
@@ -18,8 +20,9 @@ struct PlayerMetadata {
   std::string title;   // 歌曲名
   std::string artist;  // 艺术家
   std::string album;   // 专辑
-  std::string lyrics;  // 歌词内容（仅musicfox直接从dbus获取，其他查询网络获取）
-  std::int64_t length; // 歌曲时长（毫秒）
+  std::shared_ptr<const LyricsDocument> lyrics; // 解析后的歌词（仅musicfox直接从dbus获取，其他查询网络获取）
+  std::int64_t length = 0;    // 歌曲时长（毫秒）
+  std::string musicBrainzId; // xesam:musicBrainzTrackID（可能为空）
 };
 
 enum class LoopStatus {
@@ -43,14 +46,14 @@ public:
                 std::function<void(const PlayerState &)> stateCallback);
   ~PlayerManager();
 
-  // 启动D-Bus信号监听（NameOwnerChanged/PropertiesChanged）
+  // 启动D-Bus信号监听（NameOwnerChanged/PropertiesChanged），构造时在后台线程中调用
   void startMonitoring();
   // 停止监听并清理资源
   void stopMonitoring();
   // 获取当前活跃的播放器名称（优先musicfox）
   std::string getCurrentPlayerName() const;
   std::vector<std::string> getAllPlayers() const;
-  std::string switchNewPlayer() const; //切换到下一个播放器
+  std::string switchNewPlayer() const; //切换到下一个播放器（调用方持有 mutex_）
   void setCurrentPlayer(const std::string &playerName); //切换当前播放器
 
   // 新增控制方法声明
@@ -69,20 +72,46 @@ private :
   void handlePropertiesChanged(const sdbus::Signal &signal);
   void addNewPlayer(const std::string &playerName);
   std::vector<std::string> listPlayerNames();
-  PlayerState getPlayerState() const; // 根据 currentPlayer_ 获取状态信息
-  void updatePlayerState(); // 更新 currentPlayer_ 的状态信息
+  // 当前播放器的代理（没有时输出 action 对应的警告并返回 nullptr），name 为播放器名称；
+  // 代理以 shared_ptr 返回，播放器在调用期间退出时仍然有效
+  std::shared_ptr<sdbus::IProxy> currentProxy(const char *action, std::string &name) const;
+  // 根据 currentPlayer_ 获取状态信息；fetchMetadata 为 false 时复用上次的元数据
+  // （仅播放状态变化时不再重新读取包含完整歌词的 Metadata）
+  PlayerState getPlayerState(bool fetchMetadata = true) const;
+  void updatePlayerState(bool fetchMetadata = true); // 更新 currentPlayer_ 的状态信息
+  // 解析 xesam:asText 中的歌词（及可选的翻译歌词），没有歌词时返回 nullptr；
+  // 内容指纹与上次相同时直接复用已解析的文档
+  std::shared_ptr<const LyricsDocument>
+  parseLyrics(const std::map<std::string, sdbus::Variant> &metadata) const;
 
+  // 解析 Metadata 属性（Get 的结果或 PropertiesChanged 信号中的值）
   void parseMetadata(const std::map<std::string, sdbus::Variant> &metadata,
                      PlayerMetadata &out) const;
 
   // 成员变量
   std::shared_ptr<sdbus::IConnection> dbusConn_; // D-Bus连接对象
   std::shared_ptr<sdbus::IProxy> dbusProxy_; // D-Bus代理对象（用于NameOwnerChanged）
-  std::mutex mutex_;                         // 保护players_的线程安全
+  // 保护 players_ 和 currentPlayer_（D-Bus 事件循环、启动线程和 GTK 线程共用）；
+  // 持有时不调用 D-Bus 方法和状态回调
+  mutable std::mutex mutex_;
   std::thread eventLoopThread_;
-  std::map<std::string, std::unique_ptr<sdbus::IProxy>> players_; // 播放器代理
+  std::thread startThread_; // 后台执行 startMonitoring（构造函数不阻塞）
+  std::map<std::string, std::shared_ptr<sdbus::IProxy>> players_; // 播放器代理
   std::string currentPlayer_; // 当前活跃的播放器名称
-  bool isShuffle_ = false; // 随机播放标记
+  std::atomic<bool> isShuffle_{false}; // 随机播放标记
+
+  // 歌词内容指纹（哈希 + 长度），musicfox 每次属性变化都会重发完整歌词
+  struct LyricsFingerprint {
+    uint64_t hash = 0;
+    size_t length = 0;
+    uint64_t translationHash = 0;
+    bool operator==(const LyricsFingerprint &) const = default;
+  };
+  mutable std::mutex cacheMutex_; // 保护以下缓存（D-Bus 线程与调用方线程共用）
+  mutable LyricsFingerprint lyricsFingerprint_;
+  mutable std::shared_ptr<const LyricsDocument> lyricsCache_; // 指纹对应的文档
+  mutable std::string metadataPlayer_; // 缓存的元数据所属播放器
+  mutable PlayerMetadata metadataCache_; // 上次读取的元数据
   std::function<void(const PlayerState &)> stateCallback_; // 状态变更回调（通知WayLyrics）
 };
 
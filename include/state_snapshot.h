@@ -0,0 +1,27 @@
+#ifndef WAYLYRICS_STATE_SNAPSHOT_H
+#define WAYLYRICS_STATE_SNAPSHOT_H
+
+#include "player_manager.h"
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+// 最近一次的播放状态快照（state.snap）：状态变化和退出时写入，
+// 启动时先按快照显示歌词（歌词从缓存包中按 key 读取），
+// 不必等待枚举播放器、读取元数据和网络请求，之后再由播放器的实时状态校正
+struct StateSnapshot {
+  std::string playerName;
+  std::string title, artist, musicBrainzId;
+  int64_t length = 0;    // 歌曲时长（毫秒）
+  std::string lyricsKey; // 歌词在缓存包中的 key（TrackKey::key），没有歌词时为空
+  PlaybackStatus status = PlaybackStatus::Stopped;
+  uint64_t position = 0; // 保存时的播放位置（毫秒）
+  int64_t savedAt = 0;   // 保存时间（Unix 毫秒）
+
+  // 读取 dir 中的快照，文件不存在或损坏时返回 false
+  static bool load(const std::filesystem::path &dir, StateSnapshot &out);
+  // 写入临时文件后 rename 替换，失败返回 false
+  bool save(const std::filesystem::path &dir) const;
+};
+
+#endif // WAYLYRICS_STATE_SNAPSHOT_H
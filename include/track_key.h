@@ -0,0 +1,48 @@
+#ifndef WAYLYRICS_TRACK_KEY_H
+#define WAYLYRICS_TRACK_KEY_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// 去除标题末尾的版本限定：括号中或破折号之后含有 Live、Remaster、feat 等整词
+// （中文为 "现场版" 一类的词尾）的部分，可以连续多个；其余部分保留原始写法（网络查询使用）
+std::string_view stripTitleQualifiers(std::string_view title);
+// 规范化文本：Unicode 大小写折叠、全角转半角、括号和标点折叠为空格（撇号直接删除）、
+// 连续空白合并；stripQualifiers 为 true 时先用 stripTitleQualifiers 去除版本限定
+// （"(Remastered 2011)"、"【Live】"、" - Live"），再去除 "feat. xxx"。
+// 单次遍历，字符分类使用预先计算的查找表，时间复杂度 O(n)
+std::string normalizeTitle(std::string_view title, bool stripQualifiers = true);
+// 规范化歌手列表：按 , & / ; 、feat. 等拆分后逐个规范化，去重排序后以 "," 连接
+std::string normalizeArtists(std::string_view artists);
+
+// 歌曲的规范化标识：所有缓存层（LRU、缓存包）和歌词获取都使用同一个 key
+struct TrackKey {
+  std::string title;  // 规范化后的歌名（缓存 key 和本地排序使用）
+  std::string artist; // 规范化后的歌手列表
+  std::string key;    // 缓存 key（歌名为空时为空）
+
+  // 有 MusicBrainz ID 时直接以其为 key，否则为 歌名 + 歌手；
+  // 时长不在 key 中，命中后与缓存记录的时长比较
+  static TrackKey make(std::string_view title, std::string_view artist,
+                       std::string_view musicBrainzId = {});
+
+  // 模糊匹配使用的文本："歌名 歌手1 歌手2"
+  std::string searchText() const;
+  // 缓存中的 key 对应的模糊匹配文本：规范 key 取歌名和歌手，
+  // 旧版 key（"歌名_歌手"）重新规范化，MusicBrainz key 返回空
+  static std::string searchTextOf(std::string_view key);
+};
+
+class LyricsDocument;
+
+// 一次歌词查询：规范化的歌曲标识 + 播放器报告的原始信息（精确匹配时使用）
+struct LyricsQuery {
+  TrackKey track;
+  std::string title, artist, album; // 原始元数据，歌名/歌手为空时使用 track 中规范化的
+  int64_t lengthMs = 0;             // 歌曲时长（毫秒），0 表示未知
+  std::shared_ptr<const LyricsDocument> playerLyrics; // 播放器提供的歌词（player 来源）
+};
+
+#endif // WAYLYRICS_TRACK_KEY_H
@@ -0,0 +1,55 @@
+#ifndef WAYLYRICS_TRIGRAM_INDEX_H
+#define WAYLYRICS_TRIGRAM_INDEX_H
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// 缓存 key 的三元组（trigram）倒排索引，精确 key 未命中时做模糊匹配
+// （拼写差异、不同播放器的标签习惯）。
+// 索引文件 lyrics.tri 由后台线程从缓存包的 key 重建（临时文件 + rename），
+// 查询时 mmap 读取：二分查找每个三元组的倒排表并累计候选，
+// 出现过于频繁的三元组不参与累计，最后对得分最高的少量候选计算精确的 Dice 系数。
+// 重建之间新写入的 key 保存在内存中的增量索引里，与索引文件一起参与查询
+class TrigramIndex {
+public:
+  struct Match {
+    std::string key;
+    double score; // Dice 系数，0~1
+  };
+
+  explicit TrigramIndex(const std::filesystem::path &dir);
+  TrigramIndex(const TrigramIndex &) = delete;
+  TrigramIndex &operator=(const TrigramIndex &) = delete;
+
+  // 有可搜索文本的 key 才进入索引（"mb:" key 没有）
+  static bool indexable(std::string_view key);
+  // 以缓存中的 key 重建索引文件，失败返回 false；已包含在其中的增量 key 被移除
+  bool rebuild(const std::vector<std::string> &keys);
+  // 新写入缓存的 key 加入增量索引，下次重建前即可被模糊匹配找到
+  void add(std::string_view key);
+  // 索引文件中的 key 数量（不含增量，索引不存在时为 0），
+  // 与缓存中可索引的 key 数量不同时需要重建
+  size_t size();
+  // 返回与 text（TrackKey::searchText）相似度不低于 threshold 的候选，按得分降序
+  std::vector<Match> search(std::string_view text, double threshold,
+                            size_t limit = 4);
+
+private:
+  bool refresh(); // 索引文件被替换后重新映射，调用方持有 mutex_
+  void addLocked(std::string key); // 调用方持有 mutex_
+
+  std::filesystem::path path_;
+  std::mutex mutex_;
+  std::shared_ptr<const void> map_; // 索引文件映射
+  uint64_t inode_ = 0;
+  std::vector<std::string> addedKeys_; // 上次重建后本进程写入的 key
+  std::unordered_map<uint32_t, std::vector<uint32_t>> addedPostings_; // 三元组 → addedKeys_ 下标
+};
+
+#endif // WAYLYRICS_TRIGRAM_INDEX_H
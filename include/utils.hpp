@@ -1,10 +1,19 @@
 #include "common.h"
+#include "fetch_worker.h"
 #include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
 #include <cinttypes>
+#include <cstring>
 #include <curl/curl.h>
+#include <filesystem>
 #include <fstream>
+#include <memory>
 #include <nlohmann/json.hpp>
 #include <string>
+#include <string_view>
+#include <unistd.h>
 #include <vector>
 inline std::vector<std::string> split(std::string s, std::string delimiter) {
   size_t pos_start = 0, pos_end, delim_len = delimiter.length();
@@ -73,57 +82,179 @@ inline std::string &trim(std::string &s, const char *t = ws) {
   return ltrim(rtrim(s, t), t);
 }
 
-// 将 "[MM:SS.ss]" 格式的时间字符串转换为毫秒数（如 "[04:58.94]" → 298940ms）
-// 返回：成功时为毫秒数，失败时返回 0
-inline uint64_t timestampToMs(const std::string &timestampStr) {
+// 去除首尾空白（不拷贝）
+inline std::string_view trimView(std::string_view s) {
+  size_t first = s.find_first_not_of(ws);
+  if (first == std::string_view::npos) {
+    return {};
+  }
+  return s.substr(first, s.find_last_not_of(ws) - first + 1);
+}
 
-  // 步骤1：提取方括号内的时间部分（如 "[04:58.94]" → "04:58.94"）
-  size_t start = timestampStr.find('[');
-  size_t end = timestampStr.find(']');
-  if (start == std::string::npos || end == std::string::npos || start >= end) {
-    return 0;
+// 64 位内容哈希（每次处理 8 字节），用于快速判断大段文本是否变化，非加密用途
+inline uint64_t hash64(std::string_view s) {
+  uint64_t h = 0x9E3779B97F4A7C15ull ^ s.size();
+  size_t i = 0;
+  for (; i + 8 <= s.size(); i += 8) {
+    uint64_t v;
+    std::memcpy(&v, s.data() + i, sizeof(v));
+    h = (h ^ v) * 0xFF51AFD7ED558CCDull;
+    h ^= h >> 32;
+  }
+  uint64_t tail = 0;
+  if (i < s.size()) {
+    std::memcpy(&tail, s.data() + i, s.size() - i);
   }
-  std::string timePart =
-      timestampStr.substr(start + 1, end - start - 1); // 提取 "04:58.94"
+  h = (h ^ tail) * 0xC4CEB9FE1A85EC53ull;
+  return h ^ (h >> 29);
+}
 
-  // 步骤2：按 ":" 和 "." 分割时间单元（支持 "MM:SS" 或 "MM:SS.ss"）
-  size_t colonPos = timePart.find(':');
-  size_t dotPos = timePart.find('.');
-  if (colonPos == std::string::npos) {
-    return 0;
+// 写入后重命名为 path 的临时文件名：包含进程号和序号，
+// 多个进程/线程同时重写同一个文件时不会互相截断
+inline std::filesystem::path uniqueTmpPath(const std::filesystem::path &path) {
+  static std::atomic<uint32_t> sequence{0};
+  return path.string() + "." + std::to_string(getpid()) + "." +
+         std::to_string(sequence.fetch_add(1, std::memory_order_relaxed)) + ".tmp";
+}
+
+// 写入全部数据（处理部分写入，被信号中断时重试），失败时返回 false
+inline bool writeAll(int fd, const void *data, size_t size) {
+  const char *p = static_cast<const char *>(data);
+  while (size > 0) {
+    ssize_t n = write(fd, p, size);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    p += n;
+    size -= n;
   }
+  return true;
+}
 
-  // 解析分钟（MM）
-  std::string minStr = timePart.substr(0, colonPos);
-  if (!std::all_of(minStr.begin(), minStr.end(), ::isdigit)) {
-    return 0;
+inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+// 将小数部分转换为毫秒（".5"→500，".50"→500，".500"→500，多余位数截断）
+inline uint32_t fractionToMs(uint32_t value, size_t digits) {
+  switch (digits) {
+  case 1:
+    return value * 100;
+  case 2:
+    return value * 10;
+  case 3:
+    return value;
+  default:
+    while (digits-- > 3)
+      value /= 10;
+    return value;
   }
-  int minutes = std::stoi(minStr);
+}
 
-  // 解析秒（SS）
-  std::string secStr;
-  std::string centiSecStr = "0"; // 百分秒默认0
-  if (dotPos != std::string::npos) {
-    secStr = timePart.substr(colonPos + 1, dotPos - colonPos - 1);
-    centiSecStr = timePart.substr(dotPos + 1);
+// 解析时间标签内容（不含括号），成功返回 true 并写入毫秒数：
+//   mm:ss  mm:ss.x  mm:ss.xx  mm:ss.xxx  mm:ss:xx（旧式百分秒）  h:mm:ss.xxx
+// 两个冒号且没有小数点时按 mm:ss:xx 处理（播放器导出的常见写法）
+inline bool parseTimeTag(std::string_view tag, uint32_t &ms) {
+  uint32_t group[4];
+  char sep[3];
+  size_t n = 0, digits = 0, i = 0;
+  while (true) {
+    uint32_t value = 0;
+    size_t start = i;
+    for (; i < tag.size() && isDigit(tag[i]); ++i) {
+      if (i - start < 9) // 防止溢出，多余的位数只可能出现在小数部分
+        value = value * 10 + (tag[i] - '0');
+    }
+    digits = std::min<size_t>(i - start, 9); // 只累计了前 9 位
+    if (digits == 0) {
+      return false;
+    }
+    group[n++] = value;
+    if (i == tag.size()) {
+      break;
+    }
+    if (n == 4 || (tag[i] != ':' && tag[i] != '.')) {
+      return false;
+    }
+    sep[n - 1] = tag[i++];
+  }
+  // 每组最多 9 位数字，在 64 位下计算不会溢出，结果超出 uint32_t 范围时视为无效
+  uint64_t total;
+  if (n == 2 && sep[0] == ':') {
+    total = uint64_t(group[0]) * 60000 + uint64_t(group[1]) * 1000;
+  } else if (n == 3 && sep[0] == ':') {
+    total = uint64_t(group[0]) * 60000 + uint64_t(group[1]) * 1000 +
+            fractionToMs(group[2], digits);
+  } else if (n == 4 && sep[0] == ':' && sep[1] == ':' && sep[2] == '.') {
+    total = uint64_t(group[0]) * 3600000 + uint64_t(group[1]) * 60000 +
+            uint64_t(group[2]) * 1000 + fractionToMs(group[3], digits);
   } else {
-    secStr = timePart.substr(colonPos + 1);
+    return false;
   }
-  if (!std::all_of(secStr.begin(), secStr.end(), ::isdigit)) {
-    return 0;
+  if (total > UINT32_MAX) {
+    return false;
   }
-  int seconds = std::stoi(secStr);
+  ms = uint32_t(total);
+  return true;
+}
 
-  // 解析百分秒（ss，最多取两位）
-  if (centiSecStr.length() > 2)
-    centiSecStr = centiSecStr.substr(0, 2); // 截断多余位数
-  if (!std::all_of(centiSecStr.begin(), centiSecStr.end(), ::isdigit)) {
+// 扫描 s 开头的时间戳（如 "[04:58.94]" 或逐字时间戳 "<04:58.940>"）
+// 返回：成功时为时间戳长度（含括号）并写入毫秒数，失败时返回 0
+// 常见的 [mm:ss.xx] / [mm:ss.xxx] 使用 SWAR 一次校验 8 个字节，
+// 其他写法回退到 parseTimeTag；全程不分配内存
+inline size_t scanTimestamp(std::string_view s, uint32_t &ms, char open = '[',
+                            char close = ']') {
+  if (s.size() < 2 || s[0] != open) {
     return 0;
   }
-  int centiSeconds = centiSecStr.empty() ? 0 : std::stoi(centiSecStr);
+  if constexpr (std::endian::native == std::endian::little) {
+    if (s.size() >= 10) {
+      // 载入 "mm:ss.xx"，第 i 个字符位于第 i 个字节
+      uint64_t v;
+      std::memcpy(&v, s.data() + 1, sizeof(v));
+      constexpr uint64_t sepMask = 0x0000FF0000FF0000ull; // 第 2、5 字节
+      constexpr uint64_t sepValue = (uint64_t('.') << 40) | (uint64_t(':') << 16);
+      constexpr uint64_t zeros = 0x3030303030303030ull;
+      constexpr uint64_t high = 0xF0F0F0F0F0F0F0F0ull;
+      if ((v & sepMask) == sepValue) {
+        // 分隔符替换为 '0' 后，所有字节都必须是 '0'..'9'
+        uint64_t d = (v & ~sepMask) | (zeros & sepMask);
+        if ((d & high) == zeros && ((d + 0x0606060606060606ull) & high) == zeros) {
+          d &= 0x0F0F0F0F0F0F0F0Full;
+          // 相邻两位合并：字节 0/3/6 分别得到 mm、ss、xx
+          uint64_t t = d * 10 + (d >> 8);
+          uint32_t value = uint32_t(t & 0xFF) * 60000 +
+                           uint32_t((t >> 24) & 0xFF) * 1000 +
+                           uint32_t((t >> 48) & 0xFF) * 10;
+          if (s[9] == close) {
+            ms = value;
+            return 10;
+          }
+          if (s.size() >= 11 && isDigit(s[9]) && s[10] == close) {
+            ms = value + (s[9] - '0');
+            return 11;
+          }
+        }
+      }
+    }
+  }
+  size_t end = s.find(close, 1);
+  if (end == std::string_view::npos || !parseTimeTag(s.substr(1, end - 1), ms)) {
+    return 0;
+  }
+  return end + 1;
+}
 
-  // 步骤3：计算总毫秒数（分钟×60×1000 + 秒×1000 + 百分秒×10）
-  uint64_t ms = minutes * 60 * 1000 + seconds * 1000 + centiSeconds * 10;
+// 将 "[MM:SS.ss]" 格式的时间字符串转换为毫秒数（如 "[04:58.94]" → 298940ms）
+// 返回：成功时为毫秒数，失败时返回 0
+inline uint64_t timestampToMs(std::string_view timestampStr) {
+  size_t start = timestampStr.find('[');
+  uint32_t ms = 0;
+  if (start == std::string_view::npos ||
+      scanTimestamp(timestampStr.substr(start), ms) == 0) {
+    return 0;
+  }
   return ms;
 }
 
@@ -154,10 +285,12 @@ inline std::string getLyricsByLrclib(const std::string &trackName,
 
   std::string syncedLyrics = "";
 
-  CURL *curl = curl_easy_init();
-  if (curl) {
+  // 句柄在所有返回路径上释放；DNS、TLS 会话和连接与 FetchWorker 共享
+  std::unique_ptr<CURL, decltype(&curl_easy_cleanup)> handle(curl_easy_init(),
+                                                             curl_easy_cleanup);
+  if (CURL *curl = handle.get()) {
+    FetchWorker::configure(curl, {});
     curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
     curl_easy_setopt(curl, CURLOPT_WRITEDATA, &content);
     CURLcode res = curl_easy_perform(curl);
 
@@ -175,7 +308,6 @@ inline std::string getLyricsByLrclib(const std::string &trackName,
       ERROR("  >> No content received");
       return "";
     }
-    curl_easy_cleanup(curl);
   }
 
   try {
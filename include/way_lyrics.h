@@ -1,23 +1,71 @@
 #ifndef WAYLYRICS_WAY_LYRICS_H
 #define WAYLYRICS_WAY_LYRICS_H
 
+#include "cache_writer.h"
+#include "fetch_worker.h"
+#include "lyrics_lru.h"
+#include "lyrics_pack.h"
+#include "lyrics_provider.h"
+#include "negative_cache.h"
 #include "player_manager.h"
+#include "state_snapshot.h"
+#include "track_key.h"
+#include "trigram_index.h"
 #include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <filesystem>
+#include <functional>
 #include <gtk/gtk.h>
 #include <memory>
+#include <mutex>
 #include <nlohmann/json_fwd.hpp>
+#include <optional>
 #include <pthread.h>
 #include <string>
 #include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 const std::string NOPLAYER = "...";
 
+// 模块配置（由 waybar 模块配置解析得到）
+struct WayLyricsConfig {
+  std::string cssClass;        // GTK标签的CSS类名
+  std::string labelId;         // GTK标签的name属性
+  std::string destName;        // 播放器实例名称
+  int updateInterval;          // 歌词刷新间隔（秒）
+  std::string cacheDir;        // 歌词缓存目录
+  bool showTranslation = true; // 显示副歌词（"原文 / 译文"）
+  size_t cacheMemoryKb = 4096; // 内存中已解析歌词的缓存预算（KB）
+  size_t cacheMaxMb = 64;      // 磁盘缓存预算（MB），0 表示不限制
+  int cacheRefreshDays = 30;   // 缓存歌词超过该天数后在后台重新获取，0 表示不刷新
+  bool cacheSync = false;      // 每批写入缓存后 fdatasync
+  std::string lrclibUrl = "https://lrclib.net"; // lrclib 服务地址（可指向自建镜像）
+  std::string neteaseUrl = "https://music.163.com"; // 网易云音乐接口地址
+  // 歌词来源（按顺序）：本地来源 player、cache，远程来源 lrclib、netease
+  std::vector<std::string> providers = {"player", "cache", "lrclib"};
+};
+
+// 每首歌预先计算的显示内容：加载歌曲时构建一次，
+// 刷新线程只需计算行号和字号，主线程按下标取出文本，不再逐次拼接和转义
+struct RenderPlan {
+  std::shared_ptr<const LyricsDocument> lyrics; // 歌词文档（可为空）
+  std::string title, artist;                    // 对应的歌曲（判断是否需要重建）
+  std::string prefix;                           // "《歌名》歌手 - "
+  std::string prefixMarkup;                     // 转义后的前缀
+  std::vector<std::string> lines; // 每行显示文本（原文 [+ " / " + 副歌词]），已去除首尾空白
+  std::vector<std::string> wordMarkup; // 逐字高亮的 Pango 标记（按字表下标，不含前缀）
+
+  static std::shared_ptr<const RenderPlan> build(const PlayerMetadata &metadata,
+                                                 bool translation);
+};
+
 class WayLyrics {
 public:
   // 构造函数：传入配置参数（缓存目录、更新间隔、CSS类名等）
-  WayLyrics(const std::string &cacheDir, unsigned int updateInterval,
-            const std::string &cssClass);
+  explicit WayLyrics(const WayLyricsConfig &config);
   ~WayLyrics();
 
   // 核心控制方法
@@ -25,6 +73,7 @@ public:
   void stop();                 // 停止显示并清理资源
   void toggle();               // 切换启动/停止状态
   bool isRunning() const;      // 检查是否正在运行
+  void logStats();             // 输出内存/磁盘缓存统计
 
   // 播放器切换
   void nextPlayer();                    // 切换到下一个播放器
@@ -38,18 +87,78 @@ private:
   std::string
   getLyrics(const PlayerState &state); // 获取歌词（优先缓存/网络请求）
   void onPlayerStateChanged(const PlayerState &state); // 播放器状态变更回调
-  std::string getLyrics(const std::string &trackName, const std::string &artist);
+  // 获取歌词：按配置顺序查询本地来源（播放器提供的歌词、缓存），
+  // 都未命中时提交异步网络请求并返回空，获取到后由 publishLyrics 更新显示
+  std::shared_ptr<const LyricsDocument> getLyrics(const TrackKey &track,
+                                                  const PlayerMetadata &metadata);
+  // cache 来源：LRU > 缓存包（mmap 索引，规范 key 优先，其次旧版 key）> 模糊匹配
+  std::shared_ptr<const LyricsDocument> findCached(const LyricsQuery &query);
+  // 按配置创建歌词来源
+  std::vector<std::unique_ptr<LyricsProvider>> makeProviders(const WayLyricsConfig &config);
+  using LyricsCallback = LyricsProvider::Callback;
+  // 异步从远程来源获取一首歌的歌词（对冲请求，见 LyricsResolver）。
+  // 按歌曲 key 合并：同一首歌已在请求中时只登记回调，结果返回后分发给所有回调
+  void fetchTrack(const LyricsQuery &query, LyricsCallback done);
+  void onTrackFetched(const LyricsQuery &query,
+                      std::shared_ptr<const LyricsDocument> lyrics, LyricsMiss miss);
+  // 歌曲仍在显示时把获取到的歌词更新到当前状态和显示内容
+  void publishLyrics(const TrackKey &track,
+                     std::shared_ptr<const LyricsDocument> lyrics);
+  // 精确 key 未命中时在缓存中模糊匹配，时长不符的候选被排除
+  std::shared_ptr<const LyricsDocument> findSimilar(const TrackKey &track,
+                                                    int64_t lengthMs);
+  // 缓存写入时间超过 refreshAge_ 且网络正常时，加入后台刷新队列（不阻塞显示）
+  void scheduleRevalidation(const LyricsQuery &query, int64_t storedAt);
+  // 重新查询歌词，内容变化时更新缓存；等待结果时 stop 被请求则立即返回
+  void revalidate(const LyricsQuery &query, std::stop_token stop);
+  void maintenanceLoop(std::stop_token stop); // 后台维护线程：导入、压缩、刷新
+  // 交给后台写入线程写入缓存包（lengthMs 为歌曲时长，命中时用于排除其他版本）
+  void storeLyrics(const std::string &key,
+                   std::shared_ptr<const LyricsDocument> lyrics, int64_t lengthMs,
+                   LyricsSource source = LyricsSource::Network);
+  // 播放器提供的歌词写入 LRU 和缓存包（来源标记为 Player，优先于网络结果）
+  void cachePlayerLyrics(const PlayerMetadata &metadata);
+  // 按上次的状态快照设置当前状态（只读缓存，不访问网络）
+  void restoreSnapshot();
+  // 交给维护线程写入状态快照：第一次变化后 kSnapshotDelay 写入一次，
+  // 期间的多次变化（连续切歌、播放/暂停）只写最后的状态
+  void saveSnapshot(const PlayerState &state);
 
 
   // 成员变量
   std::filesystem::path cachePath;     // 歌词缓存目录
+  std::shared_ptr<LyricsPack> lyricsPack_; // 歌词缓存包（后台写入线程共享）
+  std::unique_ptr<NegativeCache> missCache_; // 已知没有歌词的歌曲
+  std::unique_ptr<TrigramIndex> trigramIndex_; // 缓存 key 的模糊匹配索引
+  std::unique_ptr<CacheWriter> cacheWriter_; // 缓存包的后台批量写入
+  std::unique_ptr<FetchWorker> fetchWorker_; // 异步网络请求线程
+  std::unique_ptr<LyricsResolver> resolver_; // 按配置顺序组合的歌词来源
+  std::mutex fetchMutex_;                    // 保护 inflight_
+  // 正在请求歌词的歌曲 key -> 等待结果的回调
+  std::unordered_map<std::string, std::vector<LyricsCallback>> inflight_;
   unsigned int updateInterval_;        // 歌词刷新间隔（秒）
   std::string cssClass_;               // GTK标签的CSS类名
+  bool showTranslation_;               // 是否显示副歌词
+  uint64_t cacheMaxBytes_;             // 磁盘缓存预算（0 表示不限制）
+  int64_t refreshAge_;                 // 缓存歌词的刷新间隔（秒，0 表示不刷新）
+  std::atomic<int64_t> lastNetworkError_{0}; // 最近一次网络错误的时间（Unix 秒）
+  std::atomic<bool> shuttingDown_{false};    // 析构中：请求以取消完成，不记录负缓存
+  std::mutex maintenanceMutex_;              // 保护刷新队列和待写入的快照
+  std::condition_variable_any maintenanceCv_;
+  std::deque<LyricsQuery> revalidateQueue_;       // 等待刷新的歌曲
+  std::unordered_set<std::string> revalidated_;   // 本次运行已刷新过的 key
+  std::optional<StateSnapshot> pendingSnapshot_;  // 等待写入的状态快照
+  std::chrono::steady_clock::time_point snapshotDue_; // pendingSnapshot_ 的写入时间
+  bool snapshotScheduled_ = false; // 有新的待写入快照，维护线程需要重新计算等待时间
   GtkLabel *displayLabel_{nullptr};    // 绑定的GTK标签（用于显示歌词）
   std::atomic<bool> isRunning_{false}; // 运行状态标记（原子操作保证线程安全）
   std::thread updateThread_{};         // 歌词刷新后台线程
   PlayerState currentState_;           // 当前播放器状态（线程安全需加锁）
+  std::shared_ptr<const RenderPlan> renderPlan_; // 当前歌曲的显示内容（stateMutex_ 保护）
+  std::weak_ptr<const LyricsDocument> writtenThrough_; // 最近写入缓存的播放器歌词（stateMutex_ 保护）
+  std::mutex stateMutex_;              // 保护 currentState_、renderPlan_ 和 writtenThrough_
   std::shared_ptr<sdbus::IConnection> dbusConn_;
+  std::jthread maintenanceThread_; // 缓存导入/压缩线程（析构时请求停止并等待）
 };
 
 #endif // WAYLYRICS_WAY_LYRICS_H
\ No newline at end of file
@@ -0,0 +1,70 @@
+#include "../include/cache_writer.h"
+#include "common.h"
+#include <algorithm>
+#include <chrono>
+
+// 收到第一条写入后等待的时间，让同一时段的写入合并为一批
+static constexpr auto kBatchDelay = std::chrono::milliseconds(200);
+
+CacheWriter::CacheWriter(std::shared_ptr<LyricsPack> pack, size_t capacity,
+                         bool sync)
+    : pack_(std::move(pack)), capacity_(std::max<size_t>(capacity, 1)),
+      sync_(sync) {
+  thread_ = std::jthread([this](std::stop_token stop) { run(stop); });
+}
+
+CacheWriter::~CacheWriter() {
+  thread_.request_stop();
+  if (thread_.joinable()) {
+    thread_.join(); // 线程退出前写完队列
+  }
+}
+
+bool CacheWriter::enqueue(std::string key,
+                          std::shared_ptr<const LyricsDocument> lyrics,
+                          LyricsSource source, int64_t lengthMs) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // 同一个 key 还未写入时只保留最新的歌词（播放器提供的歌词不被网络结果替换）
+    for (auto &w : queue_) {
+      if (w.key == key) {
+        if (w.source != LyricsSource::Player || source == LyricsSource::Player) {
+          w.lyrics = std::move(lyrics);
+          w.source = source;
+          w.lengthMs = lengthMs;
+        }
+        return true;
+      }
+    }
+    if (queue_.size() >= capacity_) {
+      WARN("  >> Cache write queue full, dropping: %s", key.c_str());
+      return false;
+    }
+    queue_.push_back({std::move(key), std::move(lyrics), source, lengthMs});
+  }
+  cv_.notify_one();
+  return true;
+}
+
+void CacheWriter::run(std::stop_token stop) {
+  std::vector<LyricsPack::Write> batch;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, stop, [this] { return !queue_.empty(); });
+      if (queue_.empty()) {
+        return; // 已请求停止且没有待写入的歌词
+      }
+      // 队列未满时稍等片刻，合并更多写入
+      cv_.wait_for(lock, stop, kBatchDelay,
+                   [this] { return queue_.size() >= capacity_; });
+      batch.swap(queue_);
+    }
+    if (pack_->insert(batch, sync_)) {
+      DEBUG("  >> Cached %zu lyrics in one batch", batch.size());
+    } else {
+      ERROR("  >> Failed to cache %zu lyrics", batch.size());
+    }
+    batch.clear();
+  }
+}
@@ -0,0 +1,394 @@
+#include "../include/fetch_worker.h"
+#include "../include/utils.hpp"
+#include "common.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <mutex>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+// 空闲池中保留的 easy 句柄上限
+static constexpr size_t kMaxIdleHandles = 8;
+// 每个主机的最大连接数（HTTP/2 时同一连接上多路复用）
+static constexpr long kMaxHostConnections = 4;
+
+CURLSH *FetchWorker::share() {
+  // 每类共享数据一把锁；共享句柄在进程退出前一直有效
+  static std::mutex locks[CURL_LOCK_DATA_LAST];
+  static CURLSH *handle = [] {
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    CURLSH *sh = curl_share_init();
+    if (!sh) {
+      ERROR("  >> curl_share_init failed");
+      return sh;
+    }
+    curl_share_setopt(sh, CURLSHOPT_LOCKFUNC,
+                      +[](CURL *, curl_lock_data data, curl_lock_access, void *) {
+                        locks[data].lock();
+                      });
+    curl_share_setopt(sh, CURLSHOPT_UNLOCKFUNC,
+                      +[](CURL *, curl_lock_data data, void *) { locks[data].unlock(); });
+    curl_share_setopt(sh, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(sh, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    return sh;
+  }();
+  return handle;
+}
+
+void FetchWorker::configure(CURL *easy, const FetchOptions &options) {
+  if (CURLSH *sh = share()) {
+    curl_easy_setopt(easy, CURLOPT_SHARE, sh);
+  }
+  curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, WriteCallback);
+  curl_easy_setopt(easy, CURLOPT_TIMEOUT, options.timeoutSeconds);
+  curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+  curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+  curl_easy_setopt(easy, CURLOPT_ACCEPT_ENCODING, ""); // libcurl 支持的全部压缩格式
+  curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L); // 等待可多路复用的连接，不另建连接
+  if (!options.caInfo.empty()) {
+    curl_easy_setopt(easy, CURLOPT_CAINFO, options.caInfo.c_str());
+  }
+}
+
+FetchWorker::Timings FetchWorker::timingsOf(CURL *easy) {
+  auto millis = [easy](CURLINFO info) {
+    curl_off_t us = 0;
+    curl_easy_getinfo(easy, info, &us);
+    return us / 1000.0;
+  };
+  Timings t;
+  t.dnsMs = millis(CURLINFO_NAMELOOKUP_TIME_T);
+  t.connectMs = millis(CURLINFO_CONNECT_TIME_T);
+  t.tlsMs = millis(CURLINFO_APPCONNECT_TIME_T);
+  t.firstByteMs = millis(CURLINFO_STARTTRANSFER_TIME_T);
+  t.totalMs = millis(CURLINFO_TOTAL_TIME_T);
+  curl_easy_getinfo(easy, CURLINFO_HTTP_VERSION, &t.httpVersion);
+  long connects = 0;
+  curl_easy_getinfo(easy, CURLINFO_NUM_CONNECTS, &connects);
+  t.reused = connects == 0;
+  return t;
+}
+
+const char *FetchWorker::httpVersionName(long version) {
+  switch (version) {
+  case CURL_HTTP_VERSION_1_0:
+    return "1.0";
+  case CURL_HTTP_VERSION_1_1:
+    return "1.1";
+  case CURL_HTTP_VERSION_2_0:
+    return "2";
+  case CURL_HTTP_VERSION_3:
+    return "3";
+  default:
+    return "?";
+  }
+}
+
+FetchWorker::FetchWorker(const FetchOptions &options) : options_(options) {
+  share(); // curl_global_init 只在这里（首次）调用，不与其他线程竞争
+  multi_ = curl_multi_init();
+  epoll_ = epoll_create1(EPOLL_CLOEXEC);
+  wake_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (!multi_ || epoll_ < 0 || wake_ < 0) {
+    ERROR("  >> Failed to initialize fetch worker: %s", strerror(errno));
+    return; // submit 会直接以失败完成
+  }
+  epoll_event ev{};
+  ev.events = EPOLLIN;
+  ev.data.fd = wake_;
+  epoll_ctl(epoll_, EPOLL_CTL_ADD, wake_, &ev);
+  curl_multi_setopt(multi_, CURLMOPT_SOCKETFUNCTION, onSocket);
+  curl_multi_setopt(multi_, CURLMOPT_SOCKETDATA, this);
+  curl_multi_setopt(multi_, CURLMOPT_TIMERFUNCTION, onTimer);
+  curl_multi_setopt(multi_, CURLMOPT_TIMERDATA, this);
+  curl_multi_setopt(multi_, CURLMOPT_PIPELINING, long(CURLPIPE_MULTIPLEX));
+  curl_multi_setopt(multi_, CURLMOPT_MAX_HOST_CONNECTIONS, kMaxHostConnections);
+  thread_ = std::jthread([this](std::stop_token stop) { run(stop); });
+}
+
+FetchWorker::~FetchWorker() {
+  if (thread_.joinable()) {
+    thread_.request_stop();
+    wake();
+    thread_.join();
+  }
+  // 请求线程已停止：定时任务（对冲请求）不再执行，其余请求以取消完成，
+  // 等待结果的调用方（future、请求合并的等待者）不会一直等下去
+  timers_.clear();
+  std::vector<std::unique_ptr<Request>> aborted;
+  for (auto &[easy, request] : active_) {
+    curl_multi_remove_handle(multi_, easy);
+    curl_easy_cleanup(easy);
+    aborted.push_back(std::move(request));
+  }
+  active_.clear();
+  for (CURL *easy : idle_) {
+    curl_easy_cleanup(easy);
+  }
+  idle_.clear();
+  // 完成回调可能提交后续请求（submit 此时直接以失败完成，不再进入 pending_）
+  aborted.insert(aborted.end(), std::make_move_iterator(pending_.begin()),
+                 std::make_move_iterator(pending_.end()));
+  pending_.clear();
+  for (auto &request : aborted) {
+    try {
+      request->done(Response{CURLE_ABORTED_BY_CALLBACK, 0, {}, {}});
+    } catch (const std::exception &e) {
+      WARN("  >> Fetch completion failed: %s", e.what());
+    }
+  }
+  if (!aborted.empty()) {
+    DEBUG("  >> Fetch worker stopped, %zu requests cancelled", aborted.size());
+  }
+  if (multi_) {
+    curl_multi_cleanup(multi_);
+  }
+  if (epoll_ >= 0) {
+    close(epoll_);
+  }
+  if (wake_ >= 0) {
+    close(wake_);
+  }
+}
+
+void FetchWorker::submit(std::string url, Completion done, CancelFlag cancel) {
+  if (!thread_.joinable()) {
+    done(Response{CURLE_FAILED_INIT, 0, {}, {}});
+    return;
+  }
+  auto request = std::make_unique<Request>();
+  request->url = std::move(url);
+  request->done = std::move(done);
+  request->cancel = std::move(cancel);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.push_back(std::move(request));
+  }
+  wake();
+}
+
+std::future<FetchWorker::Response> FetchWorker::fetch(std::string url) {
+  auto promise = std::make_shared<std::promise<Response>>();
+  auto future = promise->get_future();
+  submit(std::move(url),
+         [promise](Response &&response) { promise->set_value(std::move(response)); });
+  return future;
+}
+
+void FetchWorker::cancel(const CancelFlag &flag) {
+  if (flag && !flag->exchange(true)) {
+    wake(); // 由请求线程中止（multi 句柄只能在请求线程中操作）
+  }
+}
+
+void FetchWorker::schedule(std::chrono::milliseconds delay, std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    timers_.emplace(std::chrono::steady_clock::now() + delay, std::move(task));
+  }
+  wake(); // 重新计算 epoll_wait 的超时
+}
+
+void FetchWorker::wake() {
+  const uint64_t one = 1;
+  if (write(wake_, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+    WARN("  >> Failed to wake fetch worker: %s", strerror(errno));
+  }
+}
+
+int FetchWorker::onSocket(CURL *, curl_socket_t socket, int what, void *userp,
+                          void *) {
+  auto *self = static_cast<FetchWorker *>(userp);
+  if (what == CURL_POLL_REMOVE) {
+    epoll_ctl(self->epoll_, EPOLL_CTL_DEL, socket, nullptr);
+    return 0;
+  }
+  epoll_event ev{};
+  ev.events = ((what & CURL_POLL_IN) ? uint32_t(EPOLLIN) : 0) |
+              ((what & CURL_POLL_OUT) ? uint32_t(EPOLLOUT) : 0);
+  ev.data.fd = socket;
+  if (epoll_ctl(self->epoll_, EPOLL_CTL_MOD, socket, &ev) != 0 &&
+      epoll_ctl(self->epoll_, EPOLL_CTL_ADD, socket, &ev) != 0) {
+    WARN("  >> epoll_ctl failed for socket %d: %s", socket, strerror(errno));
+    return -1;
+  }
+  return 0;
+}
+
+int FetchWorker::onTimer(CURLM *, long timeoutMs, void *userp) {
+  auto *self = static_cast<FetchWorker *>(userp);
+  if (timeoutMs < 0) {
+    self->deadline_.reset();
+  } else {
+    self->deadline_ = std::chrono::steady_clock::now() +
+                      std::chrono::milliseconds(timeoutMs);
+  }
+  return 0;
+}
+
+void FetchWorker::startPending() {
+  uint64_t count;
+  while (read(wake_, &count, sizeof(count)) > 0) {
+  }
+  std::vector<std::unique_ptr<Request>> requests;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    requests.swap(pending_);
+  }
+  for (auto &request : requests) {
+    if (request->cancelled()) {
+      request->done(Response{CURLE_ABORTED_BY_CALLBACK, 0, {}, {}});
+      continue;
+    }
+    CURL *easy = nullptr;
+    if (!idle_.empty()) {
+      easy = idle_.back(); // 复用句柄（保留已设置的选项）
+      idle_.pop_back();
+    } else if ((easy = curl_easy_init())) {
+      configure(easy, options_);
+    } else {
+      request->done(Response{CURLE_FAILED_INIT, 0, {}, {}});
+      continue;
+    }
+    DEBUG("  >> Fetching: %s", request->url.c_str());
+    curl_easy_setopt(easy, CURLOPT_URL, request->url.c_str());
+    curl_easy_setopt(easy, CURLOPT_WRITEDATA, &request->response.body);
+    request->easy = easy;
+    active_.emplace(easy, std::move(request));
+    curl_multi_add_handle(multi_, easy); // 通过 onTimer 安排首次处理
+  }
+}
+
+void FetchWorker::finishDone() {
+  int queued = 0;
+  while (CURLMsg *msg = curl_multi_info_read(multi_, &queued)) {
+    if (msg->msg != CURLMSG_DONE) {
+      continue;
+    }
+    CURL *easy = msg->easy_handle;
+    const CURLcode result = msg->data.result;
+    auto it = active_.find(easy);
+    curl_multi_remove_handle(multi_, easy);
+    if (it == active_.end()) {
+      release(easy);
+      continue;
+    }
+    auto request = std::move(it->second);
+    active_.erase(it);
+    Response &response = request->response;
+    response.result = result;
+    curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &response.status);
+    response.timings = timingsOf(easy);
+    release(easy);
+    const Timings &t = response.timings;
+    DEBUG("  >> Fetched %ld in %.1f ms (dns %.1f, connect %.1f, tls %.1f, "
+          "ttfb %.1f, HTTP/%s%s): %s",
+          response.status, t.totalMs, t.dnsMs, t.connectMs, t.tlsMs,
+          t.firstByteMs, httpVersionName(t.httpVersion), t.reused ? ", reused" : "",
+          request->url.c_str());
+    try {
+      request->done(std::move(request->response));
+    } catch (const std::exception &e) {
+      WARN("  >> Fetch completion failed: %s", e.what());
+    }
+  }
+}
+
+void FetchWorker::abortCancelled() {
+  std::vector<std::unique_ptr<Request>> aborted;
+  for (auto it = active_.begin(); it != active_.end();) {
+    if (!it->second->cancelled()) {
+      ++it;
+      continue;
+    }
+    // 移除后 HTTP/2 只重置这个流，HTTP/1.1 的连接会被关闭
+    curl_multi_remove_handle(multi_, it->first);
+    release(it->first);
+    aborted.push_back(std::move(it->second));
+    it = active_.erase(it);
+  }
+  for (auto &request : aborted) {
+    DEBUG("  >> Fetch cancelled: %s", request->url.c_str());
+    request->done(Response{CURLE_ABORTED_BY_CALLBACK, 0, {}, {}});
+  }
+}
+
+void FetchWorker::runTimers() {
+  std::vector<std::function<void()>> due;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto now = std::chrono::steady_clock::now();
+    auto end = timers_.upper_bound(now);
+    for (auto it = timers_.begin(); it != end; ++it) {
+      due.push_back(std::move(it->second));
+    }
+    timers_.erase(timers_.begin(), end);
+  }
+  for (auto &task : due) {
+    try {
+      task();
+    } catch (const std::exception &e) {
+      WARN("  >> Scheduled task failed: %s", e.what());
+    }
+  }
+}
+
+void FetchWorker::release(CURL *easy) {
+  if (idle_.size() >= kMaxIdleHandles) {
+    curl_easy_cleanup(easy);
+    return;
+  }
+  curl_easy_setopt(easy, CURLOPT_WRITEDATA, nullptr); // 不再引用已完成的请求
+  idle_.push_back(easy);
+}
+
+void FetchWorker::run(std::stop_token stop) {
+  int running = 0;
+  epoll_event events[16];
+  while (!stop.stop_requested()) {
+    // 等到 curl 的超时和最早的定时任务中较早的一个
+    std::optional<std::chrono::steady_clock::time_point> until = deadline_;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!timers_.empty() && (!until || timers_.begin()->first < *until)) {
+        until = timers_.begin()->first;
+      }
+    }
+    int timeout = -1;
+    if (until) {
+      const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(
+          *until - std::chrono::steady_clock::now());
+      timeout = std::max<int64_t>(0, remaining.count());
+    }
+    const int n = epoll_wait(epoll_, events, std::size(events), timeout);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      ERROR("  >> epoll_wait failed: %s", strerror(errno));
+      break;
+    }
+    for (int i = 0; i < n; ++i) {
+      if (events[i].data.fd == wake_) {
+        startPending();
+        abortCancelled();
+        continue;
+      }
+      const uint32_t e = events[i].events;
+      const int flags = ((e & EPOLLIN) ? CURL_CSELECT_IN : 0) |
+                        ((e & EPOLLOUT) ? CURL_CSELECT_OUT : 0) |
+                        ((e & (EPOLLERR | EPOLLHUP)) ? CURL_CSELECT_ERR : 0);
+      curl_multi_socket_action(multi_, events[i].data.fd, flags, &running);
+    }
+    if (deadline_ && std::chrono::steady_clock::now() >= *deadline_) {
+      deadline_.reset(); // 处理时 curl 可能通过 onTimer 设置新的超时
+      curl_multi_socket_action(multi_, CURL_SOCKET_TIMEOUT, 0, &running);
+    }
+    finishDone();
+    runTimers();
+  }
+}
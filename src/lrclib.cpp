@@ -0,0 +1,221 @@
+#include "../include/lrclib.h"
+#include "../include/utils.hpp"
+#include "common.h"
+#include <cmath>
+#include <mutex>
+#include <nlohmann/json.hpp>
+
+// 精确匹配使用原始元数据（lrclib 按原始写法建立索引），没有时使用规范化的
+static const std::string &titleOf(const LyricsQuery &query) {
+  return query.title.empty() ? query.track.title : query.title;
+}
+
+static const std::string &artistOf(const LyricsQuery &query) {
+  return query.artist.empty() ? query.track.artist : query.artist;
+}
+
+static bool hasText(const nlohmann::json &record, const char *field) {
+  auto it = record.find(field);
+  return it != record.end() && it->is_string() && !it->get_ref<const std::string &>().empty();
+}
+
+static std::shared_ptr<const LyricsDocument> syncedOf(const nlohmann::json &record) {
+  return LyricsDocument::parse(record["syncedLyrics"].get_ref<const std::string &>());
+}
+
+static std::string stringOf(const nlohmann::json &record, const char *field) {
+  return hasText(record, field) ? record[field].get<std::string>() : std::string();
+}
+
+std::string lrclibGetUrl(std::string_view baseUrl, const LyricsQuery &query) {
+  const std::string &title = titleOf(query), &artist = artistOf(query);
+  if (title.empty() || artist.empty() || query.lengthMs <= 0) {
+    return {};
+  }
+  std::string url(baseUrl);
+  url += "/api/get?track_name=" + url_encode(title) +
+         "&artist_name=" + url_encode(artist);
+  if (!query.album.empty()) {
+    url += "&album_name=" + url_encode(query.album);
+  }
+  url += "&duration=" + std::to_string((query.lengthMs + 500) / 1000); // 秒
+  return url;
+}
+
+std::string lrclibSearchUrl(std::string_view baseUrl, const LyricsQuery &query,
+                            bool withArtist) {
+  // 模糊查询使用原始写法，只去除末尾的版本限定（"(Live)"、" - 2011 Remaster"）；
+  // 规范化的歌名/歌手只用于缓存 key 和本地排序（大小写、标点折叠后服务端反而匹配不到）
+  std::string url(baseUrl);
+  url += "/api/search?track_name=" + url_encode(std::string(stripTitleQualifiers(titleOf(query))));
+  const std::string &artist = artistOf(query);
+  if (withArtist && !artist.empty()) {
+    url += "&artist_name=" + url_encode(artist);
+  }
+  return url;
+}
+
+std::shared_ptr<const LyricsDocument> parseLrclibGet(std::string_view body,
+                                                     LyricsMiss &miss) {
+  miss = LyricsMiss::NetworkError;
+  auto json = nlohmann::json::parse(body, nullptr, false);
+  if (json.is_discarded() || !json.is_object()) {
+    WARN("  >> Invalid lrclib response");
+    return nullptr;
+  }
+  if (hasText(json, "syncedLyrics")) {
+    return syncedOf(json);
+  }
+  // 纯音乐或只有纯文本歌词
+  miss = hasText(json, "plainLyrics") ? LyricsMiss::NoSynced : LyricsMiss::NotFound;
+  return nullptr;
+}
+
+std::shared_ptr<const LyricsDocument>
+parseLrclibSearch(std::string_view body, const LyricsQuery &query,
+                  int64_t toleranceMs, LyricsMiss &miss) {
+  miss = LyricsMiss::NetworkError;
+  auto json = nlohmann::json::parse(body, nullptr, false);
+  if (json.is_discarded() || !json.is_array()) {
+    WARN("  >> Invalid lrclib response");
+    return nullptr;
+  }
+  miss = LyricsMiss::NotFound;
+  // 按 rankCandidate 排序，相同时保留先出现的结果（lrclib 的相关度顺序）
+  const nlohmann::json *best = nullptr;
+  MatchRank bestRank{};
+  for (const auto &record : json) {
+    if (!record.is_object()) {
+      continue;
+    }
+    int64_t durationMs = 0;
+    auto duration = record.find("duration");
+    if (duration != record.end() && duration->is_number()) {
+      durationMs = std::llround(duration->get<double>() * 1000);
+    }
+    MatchRank rank;
+    if (!rankCandidate(query, stringOf(record, "trackName"),
+                       stringOf(record, "artistName"), durationMs, toleranceMs, rank)) {
+      continue; // 其他版本（现场、混音等）
+    }
+    if (!hasText(record, "syncedLyrics")) {
+      if (hasText(record, "plainLyrics")) {
+        miss = LyricsMiss::NoSynced;
+      }
+      continue;
+    }
+    if (!best || rank < bestRank) {
+      best = &record;
+      bestRank = rank;
+    }
+  }
+  if (!best) {
+    return nullptr;
+  }
+  DEBUG("  >> lrclib search picked %s - %s (duration delta %ld ms)",
+        stringOf(*best, "trackName").c_str(), stringOf(*best, "artistName").c_str(),
+        std::get<2>(bestRank));
+  return syncedOf(*best);
+}
+
+LrclibProvider::LrclibProvider(FetchWorker &worker, std::string baseUrl)
+    : LyricsProvider({"lrclib", kProviderSynced, 3, std::chrono::milliseconds(800)}),
+      worker_(worker), baseUrl_(std::move(baseUrl)) {
+  while (baseUrl_.ends_with('/')) {
+    baseUrl_.pop_back();
+  }
+}
+
+void LrclibProvider::lookup(const LyricsQuery &query,
+                            const FetchWorker::CancelFlag &cancel, Callback done) {
+  // 先按歌名、歌手、专辑和时长精确匹配（只返回一条记录）
+  const std::string url = lrclibGetUrl(baseUrl_, query);
+  if (url.empty()) {
+    searchTrack(query, cancel, std::move(done));
+    return;
+  }
+  worker_.submit(url, [this, query, cancel, done](FetchWorker::Response &&response) {
+    LyricsMiss miss = LyricsMiss::NetworkError;
+    std::shared_ptr<const LyricsDocument> lyrics;
+    if (checkLyricsResponse(response, miss)) {
+      lyrics = parseLrclibGet(response.body, miss);
+    }
+    if (lyrics || miss == LyricsMiss::NetworkError || (cancel && cancel->load())) {
+      done(std::move(lyrics), miss);
+      return;
+    }
+    // 没有精确匹配（或只有纯文本歌词）时模糊查询
+    searchTrack(query, cancel, done);
+  }, cancel);
+}
+
+void LrclibProvider::searchTrack(const LyricsQuery &query,
+                                 const FetchWorker::CancelFlag &cancel, Callback done) {
+  if (query.track.artist.empty()) {
+    searchLyrics(query, false, cancel, std::move(done));
+    return;
+  }
+  struct Plan {
+    std::mutex mutex;
+    int pending = 2;
+    bool finished = false;
+    std::shared_ptr<const LyricsDocument> titleLyrics;
+    LyricsMiss artistMiss = LyricsMiss::NotFound, titleMiss = LyricsMiss::NotFound;
+  };
+  auto plan = std::make_shared<Plan>();
+  // 两个查询都结束时调用：记录有效期更短的原因（网络错误 < 无时间轴 < 无结果）
+  auto settle = [plan, done](std::unique_lock<std::mutex> &lock) {
+    if (--plan->pending > 0) {
+      return;
+    }
+    plan->finished = true;
+    auto lyrics = std::move(plan->titleLyrics);
+    const LyricsMiss miss = std::max(plan->artistMiss, plan->titleMiss);
+    lock.unlock();
+    done(std::move(lyrics), miss);
+  };
+  searchLyrics(query, true, cancel,
+               [plan, done, settle](std::shared_ptr<const LyricsDocument> lyrics,
+                                    LyricsMiss miss) {
+    std::unique_lock<std::mutex> lock(plan->mutex);
+    if (plan->finished) {
+      return;
+    }
+    if (lyrics) {
+      plan->finished = true; // 不再等待只按歌名的结果
+      lock.unlock();
+      done(std::move(lyrics), miss);
+      return;
+    }
+    plan->artistMiss = miss;
+    settle(lock);
+  });
+  searchLyrics(query, false, cancel,
+               [plan, settle](std::shared_ptr<const LyricsDocument> lyrics,
+                              LyricsMiss miss) {
+    std::unique_lock<std::mutex> lock(plan->mutex);
+    if (plan->finished) {
+      return;
+    }
+    plan->titleLyrics = std::move(lyrics);
+    plan->titleMiss = miss;
+    settle(lock);
+  });
+}
+
+void LrclibProvider::searchLyrics(const LyricsQuery &query, bool withArtist,
+                                  const FetchWorker::CancelFlag &cancel, Callback done) {
+  if (query.track.title.empty()) {
+    done(nullptr, LyricsMiss::NotFound);
+    return;
+  }
+  worker_.submit(lrclibSearchUrl(baseUrl_, query, withArtist),
+                 [query, done = std::move(done)](FetchWorker::Response &&response) {
+    LyricsMiss miss = LyricsMiss::NetworkError;
+    std::shared_ptr<const LyricsDocument> lyrics;
+    if (checkLyricsResponse(response, miss)) {
+      lyrics = parseLrclibSearch(response.body, query, kLengthTolerance, miss);
+    }
+    done(std::move(lyrics), miss);
+  }, cancel);
+}
@@ -0,0 +1,572 @@
+#include "../include/lyrics_document.h"
+#include "../include/lyrics_builder.h"
+#include "../include/utils.hpp"
+#include "common.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// 游标最多向前线性移动的行数，超过后改用二分查找
+static constexpr size_t kMaxForwardSteps = 4;
+// 合并翻译时允许的时间戳误差（毫秒）
+static constexpr uint32_t kMergeToleranceMs = 100;
+// [offset:] 的绝对值上限（毫秒），超出视为无效标签
+static constexpr int64_t kMaxOffsetMs = 24 * 3600 * 1000;
+
+void LyricsBuilder::parse(std::string_view content) {
+  // 跳过 UTF-8 BOM
+  if (content.starts_with("\xEF\xBB\xBF")) {
+    content.remove_prefix(3);
+  }
+  // 预估容量，解析过程中不再扩容
+  text_.reserve(content.size());
+  lines_.reserve(std::count(content.begin(), content.end(), '\n') + 1);
+  switch (sniffLyricsFormat(content)) {
+  case LyricsFormat::Srt:
+  case LyricsFormat::WebVtt:
+    parseCues(content);
+    break;
+  case LyricsFormat::Ttml:
+    parseTtml(content);
+    break;
+  default:
+    parseLrc(content);
+    break;
+  }
+  if (lineOpen_) {
+    closeLine();
+  }
+
+  // 应用 [offset:]：正值表示歌词提前显示
+  if (offsetMs_ != 0) {
+    for (auto &l : lines_) {
+      int64_t start = static_cast<int64_t>(l.startMs) - offsetMs_;
+      l.startMs = static_cast<uint32_t>(std::clamp<int64_t>(start, 0, UINT32_MAX));
+    }
+  }
+  // 多时间戳行或乱序歌词需要排序（稳定排序保持同一时间戳行的原始顺序）
+  auto byStart = [](const LyricsLine &a, const LyricsLine &b) {
+    return a.startMs < b.startMs;
+  };
+  if (!std::is_sorted(lines_.begin(), lines_.end(), byStart)) {
+    std::stable_sort(lines_.begin(), lines_.end(), byStart);
+  }
+  foldDuplicates();
+}
+
+void LyricsBuilder::parseLrc(std::string_view content) {
+  size_t pos = 0;
+  while (pos < content.size()) {
+    size_t end = content.find('\n', pos);
+    if (end == std::string_view::npos) {
+      end = content.size();
+    }
+    parseLrcLine(content.substr(pos, end - pos));
+    pos = end + 1;
+  }
+}
+
+void LyricsBuilder::foldDuplicates() {
+  // 排序后原地压缩：同一时间戳的第二行文本作为第一行的副歌词，其余重复行丢弃
+  size_t out = 0;
+  for (size_t i = 0; i < lines_.size(); ++i) {
+    if (out > 0 && lines_[out - 1].startMs == lines_[i].startMs) {
+      auto &prev = lines_[out - 1];
+      const auto &cur = lines_[i];
+      std::string_view prevText(text_.data() + prev.textOffset, prev.textLength);
+      std::string_view curText(text_.data() + cur.textOffset, cur.textLength);
+      if (prev.subLength == 0 && cur.textLength != 0 && curText != prevText) {
+        prev.subOffset = cur.textOffset;
+        prev.subLength = cur.textLength;
+      }
+      continue;
+    }
+    lines_[out++] = lines_[i];
+  }
+  lines_.resize(out);
+}
+
+void LyricsBuilder::merge(const LyricsBuilder &translation) {
+  // 两边都已按时间排序，双指针线性合并，只在加载时执行一次
+  const auto &other = translation.lines_;
+  size_t j = 0;
+  for (auto &l : lines_) {
+    while (j < other.size() && other[j].startMs + kMergeToleranceMs < l.startMs) {
+      ++j;
+    }
+    if (j == other.size()) {
+      break;
+    }
+    const auto &t = other[j];
+    if (t.startMs > l.startMs + kMergeToleranceMs || t.textLength == 0) {
+      continue;
+    }
+    std::string_view sub(translation.text_.data() + t.textOffset, t.textLength);
+    std::string_view text(text_.data() + l.textOffset, l.textLength);
+    std::string_view current(text_.data() + l.subOffset, l.subLength);
+    if (sub != text && sub != current) {
+      // 已有副歌词（同一歌词中的"原文+译文"行）时追加在后面，不覆盖
+      LyricsText ref;
+      if (l.subLength == 0) {
+        ref = appendText(sub);
+      } else {
+        std::string joined;
+        joined.reserve(current.size() + sub.size() + 3);
+        joined.append(current).append(" / ").append(sub);
+        ref = appendText(joined);
+      }
+      l.subOffset = ref.offset;
+      l.subLength = ref.length;
+    }
+    ++j;
+  }
+}
+
+void LyricsBuilder::parseLrcLine(std::string_view cur) {
+  // 读取行首的所有时间戳，每个时间戳先占一行，文本解析完成后回填
+  size_t i = 0;
+  while (i < cur.size() && cur[i] == '[') {
+    uint32_t ms = 0;
+    size_t len = i + 1 < cur.size() && isDigit(cur[i + 1])
+                     ? scanTimestamp(cur.substr(i), ms)
+                     : 0;
+    if (len != 0) {
+      openLine(ms);
+      i += len;
+      continue;
+    }
+    size_t close = cur.find(']', i);
+    if (close == std::string_view::npos) {
+      break;
+    }
+    std::string_view tag = cur.substr(i + 1, close - i - 1);
+    if (!lineOpen_) {
+      // 标签行：[key:value]
+      size_t colon = tag.find(':');
+      if (colon != std::string_view::npos) {
+        parseTag(trimView(tag.substr(0, colon)), trimView(tag.substr(colon + 1)));
+      }
+      return;
+    }
+    break; // 时间戳后以 '[' 开头的歌词文本
+  }
+  if (!lineOpen_) {
+    return; // 没有时间戳的行（空行、纯文本）
+  }
+
+  // 剥离行内逐字时间戳，文本直接写入字符串表
+  std::string_view body = cur.substr(i);
+  i = 0;
+  while (i < body.size()) {
+    size_t tagLen = 0;
+    uint32_t wordMs = 0;
+    if (body[i] == '<' && i + 1 < body.size() && isDigit(body[i + 1]) &&
+        (tagLen = scanTimestamp(body.substr(i), wordMs, '<', '>')) != 0) {
+      markWord(wordMs);
+      i += tagLen;
+      continue;
+    }
+    size_t next = body.find('<', i + 1);
+    if (next == std::string_view::npos) {
+      next = body.size();
+    }
+    text_.append(body.substr(i, next - i));
+    i = next;
+  }
+  closeLine();
+}
+
+void LyricsBuilder::openLine(uint32_t startMs) {
+  if (!lineOpen_) {
+    lineOpen_ = true;
+    lineFirst_ = lines_.size();
+    lineStart_ = text_.size();
+    wordBegin_ = words_.size();
+  }
+  lines_.push_back({startMs, 0, 0, 0, 0, 0, 0});
+}
+
+void LyricsBuilder::markWord(uint32_t ms) {
+  // 上一个字到当前位置结束，字时间相对行开始时间
+  if (words_.size() > wordBegin_) {
+    auto &prev = words_.back();
+    prev.textLength =
+        static_cast<uint16_t>(text_.size() - lineStart_ - prev.textOffset);
+  }
+  const uint32_t lineMs = lines_[lineFirst_].startMs;
+  words_.push_back({ms > lineMs ? ms - lineMs : 0,
+                    static_cast<uint16_t>(text_.size() - lineStart_), 0});
+}
+
+void LyricsBuilder::closeLine(std::string_view sub) {
+  if (!lineOpen_) {
+    return;
+  }
+  lineOpen_ = false;
+  const size_t lineStart = lineStart_;
+  const size_t wordBegin = wordBegin_;
+  if (words_.size() > wordBegin) {
+    auto &last = words_.back();
+    last.textLength =
+        static_cast<uint16_t>(text_.size() - lineStart - last.textOffset);
+  }
+
+  // 去除首尾空白（含 \r），同步修正字的偏移
+  size_t lastChar = text_.find_last_not_of(ws);
+  text_.resize(lastChar == std::string::npos || lastChar < lineStart
+                   ? lineStart
+                   : lastChar + 1);
+  size_t lead =
+      std::min(text_.find_first_not_of(ws, lineStart), text_.size()) - lineStart;
+  text_.erase(lineStart, lead);
+  size_t lineLength = std::min<size_t>(text_.size() - lineStart, UINT16_MAX);
+  // 超长行截断时退回到 UTF-8 字符边界（不截断多字节字符）
+  while (lineLength > 0 && lineStart + lineLength < text_.size() &&
+         (static_cast<unsigned char>(text_[lineStart + lineLength]) & 0xC0) == 0x80) {
+    --lineLength;
+  }
+  text_.resize(lineStart + lineLength);
+  for (auto w = words_.begin() + wordBegin; w != words_.end(); ++w) {
+    size_t from = w->textOffset > lead ? w->textOffset - lead : 0;
+    size_t to = std::min<size_t>(
+        std::max<size_t>(w->textOffset + w->textLength, lead) - lead,
+        lineLength);
+    w->textOffset = static_cast<uint16_t>(std::min(from, lineLength));
+    w->textLength = static_cast<uint16_t>(to > from ? to - from : 0);
+  }
+  // 末尾的时间戳只标记最后一个字的结束，不是独立的字
+  while (words_.size() > wordBegin && words_.back().textLength == 0) {
+    words_.pop_back();
+  }
+  LyricsText subRef = appendText(sub);
+
+  // 回填本行所有时间戳共享的文本和字表
+  for (size_t l = lineFirst_; l < lines_.size(); ++l) {
+    lines_[l].textOffset = static_cast<uint32_t>(lineStart);
+    lines_[l].textLength = static_cast<uint16_t>(lineLength);
+    lines_[l].wordCount = static_cast<uint16_t>(words_.size() - wordBegin);
+    lines_[l].wordBegin = static_cast<uint32_t>(wordBegin);
+    lines_[l].subOffset = subRef.offset;
+    lines_[l].subLength = subRef.length;
+  }
+}
+
+void LyricsBuilder::parseTag(std::string_view key, std::string_view value) {
+  auto is = [key](std::string_view name) {
+    return key.size() == name.size() &&
+           std::equal(key.begin(), key.end(), name.begin(), [](char a, char b) {
+             return std::tolower((unsigned char)a) == b;
+           });
+  };
+  if (is("ti")) {
+    title_ = appendText(value);
+  } else if (is("ar")) {
+    artist_ = appendText(value);
+  } else if (is("al")) {
+    album_ = appendText(value);
+  } else if (is("length")) {
+    parseTimeTag(value, lengthMs_);
+  } else if (is("offset")) {
+    int64_t sign = 1, offset = 0;
+    if (!value.empty() && (value[0] == '+' || value[0] == '-')) {
+      sign = value[0] == '-' ? -1 : 1;
+      value.remove_prefix(1);
+    }
+    for (char c : value) {
+      if (!isDigit(c))
+        return;
+      offset = offset * 10 + (c - '0');
+      if (offset > kMaxOffsetMs)
+        return;
+    }
+    offsetMs_ = static_cast<int32_t>(sign * offset);
+  }
+}
+
+LyricsText LyricsBuilder::appendText(std::string_view text) {
+  text = trimView(text);
+  LyricsText r{static_cast<uint32_t>(text_.size()),
+            static_cast<uint32_t>(text.size())};
+  text_.append(text);
+  return r;
+}
+
+// arena 中各部分按 8 字节对齐
+static size_t alignUp(size_t n) { return (n + 7) & ~size_t(7); }
+
+// 各部分在 arena 中的起始位置
+struct ArenaLayout {
+  size_t linesAt, wordsAt, textAt, size;
+  ArenaLayout(size_t lineCount, size_t wordCount, size_t textSize)
+      : linesAt(alignUp(sizeof(LyricsDocumentHeader))),
+        wordsAt(alignUp(linesAt + lineCount * sizeof(LyricsLine))),
+        textAt(alignUp(wordsAt + wordCount * sizeof(LyricsWord))),
+        size(textAt + textSize) {}
+};
+
+std::shared_ptr<const LyricsDocument> LyricsBuilder::finish() const {
+  const ArenaLayout layout(lines_.size(), words_.size(), text_.size());
+  auto arena = std::make_shared_for_overwrite<std::byte[]>(layout.size);
+  LyricsDocumentHeader header{};
+  header.magic = kLyricsMagic;
+  header.version = kLyricsVersion;
+  header.byteSize = static_cast<uint32_t>(layout.size);
+  header.lineCount = static_cast<uint32_t>(lines_.size());
+  header.wordCount = static_cast<uint32_t>(words_.size());
+  header.textSize = static_cast<uint32_t>(text_.size());
+  header.lengthMs = lengthMs_;
+  header.offsetMs = offsetMs_;
+  header.title = title_;
+  header.artist = artist_;
+  header.album = album_;
+  std::memset(arena.get(), 0, layout.textAt);
+  std::memcpy(arena.get(), &header, sizeof(header));
+  // 空 vector 的 data() 可能为空指针，不能传给 memcpy（没有逐字时间的歌词 words_ 为空）
+  if (!lines_.empty()) {
+    std::memcpy(arena.get() + layout.linesAt, lines_.data(),
+                lines_.size() * sizeof(LyricsLine));
+  }
+  if (!words_.empty()) {
+    std::memcpy(arena.get() + layout.wordsAt, words_.data(),
+                words_.size() * sizeof(LyricsWord));
+  }
+  if (!text_.empty()) {
+    std::memcpy(arena.get() + layout.textAt, text_.data(), text_.size());
+  }
+  const std::byte *data = arena.get();
+  return std::shared_ptr<const LyricsDocument>(
+      new LyricsDocument(std::move(arena), data, layout.size));
+}
+
+std::shared_ptr<const LyricsDocument>
+LyricsDocument::parse(std::string_view syncedLyrics,
+                      std::string_view translation) {
+  LyricsBuilder builder;
+  builder.parse(syncedLyrics);
+  if (builder.lines_.empty()) {
+    return nullptr;
+  }
+  if (!translation.empty()) {
+    LyricsBuilder sub;
+    sub.parse(translation);
+    builder.merge(sub);
+  }
+  auto doc = builder.finish();
+  DEBUG("  >> LyricsDocument built: %zu lines, %u words, %zu bytes, offset=%d",
+        doc->size(), doc->header_->wordCount, doc->byteSize(), doc->offsetMs());
+  return doc;
+}
+
+bool LyricsDocument::validate(const std::byte *data, size_t size) {
+  LyricsDocumentHeader h;
+  if (size < sizeof(h) || reinterpret_cast<uintptr_t>(data) % 8 != 0) {
+    return false;
+  }
+  std::memcpy(&h, data, sizeof(h));
+  if (h.magic != kLyricsMagic || h.version != kLyricsVersion ||
+      h.byteSize != size || h.lineCount == 0) {
+    return false;
+  }
+  const ArenaLayout layout(h.lineCount, h.wordCount, h.textSize);
+  if (layout.size != size) {
+    return false;
+  }
+  // 只校验边界，保证损坏的缓存文件不会越界访问
+  auto inText = [&h](uint64_t offset, uint64_t length) {
+    return offset + length <= h.textSize;
+  };
+  if (!inText(h.title.offset, h.title.length) ||
+      !inText(h.artist.offset, h.artist.length) ||
+      !inText(h.album.offset, h.album.length)) {
+    return false;
+  }
+  auto *lines = reinterpret_cast<const LyricsLine *>(data + layout.linesAt);
+  auto *words = reinterpret_cast<const LyricsWord *>(data + layout.wordsAt);
+  for (uint32_t i = 0; i < h.lineCount; ++i) {
+    const auto &l = lines[i];
+    if (!inText(l.textOffset, l.textLength) || !inText(l.subOffset, l.subLength) ||
+        uint64_t(l.wordBegin) + l.wordCount > h.wordCount ||
+        (i > 0 && lines[i - 1].startMs > l.startMs)) {
+      return false;
+    }
+    for (uint32_t w = l.wordBegin; w < l.wordBegin + l.wordCount; ++w) {
+      if (words[w].textOffset + words[w].textLength > l.textLength) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+std::shared_ptr<const LyricsDocument>
+LyricsDocument::fromImage(std::shared_ptr<const void> owner,
+                          const std::byte *data, size_t size) {
+  if (!validate(data, size)) {
+    return nullptr;
+  }
+  return std::shared_ptr<const LyricsDocument>(
+      new LyricsDocument(std::move(owner), data, size));
+}
+
+// 写入 "mm:ss.xxx" 形式的时间（分钟数不限两位，parseTimeTag 可还原）
+static void appendTime(std::string &out, uint64_t ms) {
+  char buf[32];
+  const int n = snprintf(buf, sizeof(buf), "%02llu:%02llu.%03llu",
+                         (unsigned long long)(ms / 60000),
+                         (unsigned long long)(ms / 1000 % 60),
+                         (unsigned long long)(ms % 1000));
+  out.append(buf, n);
+}
+
+// 行文本中的换行替换为空格，保证每行歌词仍是一行 LRC
+static void appendLrcText(std::string &out, std::string_view text) {
+  for (char c : text) {
+    out.push_back(c == '\n' || c == '\r' ? ' ' : c);
+  }
+}
+
+std::string LyricsDocument::toLrc() const {
+  std::string out;
+  out.reserve(header_->textSize + size() * 16 + header_->wordCount * 11);
+  const std::pair<const char *, std::string_view> tags[] = {
+      {"ti", title()}, {"ar", artist()}, {"al", album()}};
+  for (const auto &[key, value] : tags) {
+    if (!value.empty()) {
+      out.append("[").append(key).append(":");
+      appendLrcText(out, value);
+      out.append("]\n");
+    }
+  }
+  if (lengthMs() != 0) {
+    out.append("[length:");
+    appendTime(out, lengthMs());
+    out.append("]\n");
+  }
+  // offset 已应用到各行的时间，不再写出
+  for (size_t i = 0; i < size(); ++i) {
+    const LyricsLine &l = lines_[i];
+    const std::string_view line = text(i);
+    out.push_back('[');
+    appendTime(out, l.startMs);
+    out.push_back(']');
+    size_t at = 0;
+    for (uint32_t w = 0; w < l.wordCount; ++w) {
+      const LyricsWord &word = words_[l.wordBegin + w];
+      appendLrcText(out, line.substr(at, word.textOffset - at));
+      out.push_back('<');
+      appendTime(out, uint64_t(l.startMs) + word.offsetMs);
+      out.push_back('>');
+      at = word.textOffset;
+    }
+    appendLrcText(out, line.substr(at));
+    out.push_back('\n');
+    // 副歌词写为相同时间戳的下一行，解析时合并回本行
+    if (l.subLength != 0) {
+      out.push_back('[');
+      appendTime(out, l.startMs);
+      out.push_back(']');
+      appendLrcText(out, subText(i));
+      out.push_back('\n');
+    }
+  }
+  return out;
+}
+
+LyricsDocument::LyricsDocument(std::shared_ptr<const void> storage,
+                               const std::byte *data, size_t size)
+    : storage_(std::move(storage)), data_(data), byteSize_(size),
+      header_(reinterpret_cast<const LyricsDocumentHeader *>(data)) {
+  const ArenaLayout layout(header_->lineCount, header_->wordCount,
+                           header_->textSize);
+  lines_ = reinterpret_cast<const LyricsLine *>(data + layout.linesAt);
+  words_ = reinterpret_cast<const LyricsWord *>(data + layout.wordsAt);
+  text_ = reinterpret_cast<const char *>(data + layout.textAt);
+}
+
+std::string_view LyricsDocument::text(size_t index) const {
+  if (index >= size()) {
+    return {};
+  }
+  const auto &l = lines_[index];
+  return std::string_view(text_ + l.textOffset, l.textLength);
+}
+
+std::string_view LyricsDocument::subText(size_t index) const {
+  if (index >= size()) {
+    return {};
+  }
+  const auto &l = lines_[index];
+  return std::string_view(text_ + l.subOffset, l.subLength);
+}
+
+const LyricsWord *LyricsDocument::words(size_t index) const {
+  if (index >= size()) {
+    return nullptr;
+  }
+  return words_ + lines_[index].wordBegin;
+}
+
+size_t LyricsDocument::search(uint64_t pos, size_t first) const {
+  // 找到第一个 startMs > pos 的行，其前一行即为当前行
+  auto it = std::upper_bound(
+      lines_ + first, lines_ + size(), pos,
+      [](uint64_t p, const LyricsLine &l) { return p < l.startMs; });
+  size_t index = it - lines_;
+  return index == 0 ? 0 : index - 1;
+}
+
+size_t LyricsDocument::lineAt(uint64_t pos, LyricsCursor &cursor) const {
+  if (empty()) {
+    return npos;
+  }
+  size_t index = cursor.index;
+  if (index >= size() || lines_[index].startMs > pos) {
+    // 游标无效或播放位置回退（跳转）：二分查找
+    index = search(pos, 0);
+  } else {
+    // 正常播放：从游标位置向前移动
+    size_t steps = 0;
+    while (index + 1 < size() && lines_[index + 1].startMs <= pos) {
+      if (++steps > kMaxForwardSteps) {
+        index = search(pos, index); // 向前跳转较远
+        break;
+      }
+      ++index;
+    }
+  }
+  if (index != cursor.index) {
+    cursor.word = npos; // 换行后字游标失效
+  }
+  cursor.index = index;
+  return index;
+}
+
+size_t LyricsDocument::wordAt(size_t index, uint64_t pos,
+                              LyricsCursor &cursor) const {
+  if (index >= size() || lines_[index].wordCount == 0 ||
+      pos < lines_[index].startMs) {
+    return npos;
+  }
+  const LyricsWord *w = words(index);
+  const size_t count = lines_[index].wordCount;
+  size_t word = cursor.index == index ? cursor.word : npos;
+  // 字时间相对行开始时间
+  const uint64_t rel = pos - lines_[index].startMs;
+  if (word >= count || w[word].offsetMs > rel) {
+    word = 0; // 游标无效或回退：从行首开始
+    if (w[0].offsetMs > rel) {
+      cursor.word = npos;
+      return npos;
+    }
+  }
+  while (word + 1 < count && w[word + 1].offsetMs <= rel) {
+    ++word;
+  }
+  if (cursor.index == index) {
+    cursor.word = word;
+  }
+  return word;
+}
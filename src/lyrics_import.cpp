@@ -0,0 +1,420 @@
+#include "../include/lyrics_builder.h"
+#include "../include/utils.hpp"
+#include <cctype>
+
+// SRT / WebVTT / TTML 导入器：与 LRC 解析共用 LyricsBuilder，
+// 单次线性遍历输入，输出同一种紧凑时间轴结构
+
+LyricsFormat sniffLyricsFormat(std::string_view content) {
+  if (content.starts_with("\xEF\xBB\xBF")) {
+    content.remove_prefix(3);
+  }
+  std::string_view head = content.substr(0, 1024);
+  size_t first = head.find_first_not_of(ws);
+  if (first == std::string_view::npos) {
+    return LyricsFormat::Lrc;
+  }
+  head.remove_prefix(first);
+  if (head.starts_with("WEBVTT")) {
+    return LyricsFormat::WebVtt;
+  }
+  if (head[0] == '<') {
+    // <?xml ...?> 之后的根元素 <tt>（可能带命名空间前缀 <tt:tt>）
+    return head.find("<tt") != std::string_view::npos ? LyricsFormat::Ttml
+                                                       : LyricsFormat::Lrc;
+  }
+  // SRT：第一条字幕为 "序号\n开始 --> 结束"，部分文件省略序号
+  size_t eol = head.find('\n');
+  std::string_view firstLine = trimView(head.substr(0, eol));
+  if (firstLine.find("-->") != std::string_view::npos) {
+    return LyricsFormat::Srt;
+  }
+  if (eol != std::string_view::npos &&
+      std::all_of(firstLine.begin(), firstLine.end(), isDigit)) {
+    std::string_view next = head.substr(eol + 1);
+    if (next.substr(0, next.find('\n')).find("-->") != std::string_view::npos) {
+      return LyricsFormat::Srt;
+    }
+  }
+  return LyricsFormat::Lrc;
+}
+
+void LyricsBuilder::appendMarkup(std::string &out, size_t from,
+                                 std::string_view s) {
+  static constexpr struct {
+    std::string_view name;
+    char c;
+  } entities[] = {{"amp", '&'}, {"lt", '<'},   {"gt", '>'},
+                  {"quot", '"'}, {"apos", '\''}, {"nbsp", ' '}};
+  size_t i = 0;
+  while (i < s.size()) {
+    char c = s[i];
+    if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+      // 连续空白合并为一个空格（XML 排版产生的缩进和换行）
+      if (out.size() > from && out.back() != ' ') {
+        out.push_back(' ');
+      }
+      ++i;
+      continue;
+    }
+    if (c == '&') {
+      size_t semi = s.find(';', i + 1);
+      if (semi != std::string_view::npos && semi - i <= 10) {
+        std::string_view name = s.substr(i + 1, semi - i - 1);
+        bool decoded = false;
+        if (name.size() > 1 && name[0] == '#') {
+          // 数字字符引用（&#NN; / &#xHH;），按 UTF-8 写入
+          uint32_t cp = 0;
+          bool hex = name[1] == 'x' || name[1] == 'X';
+          decoded = name.size() > (hex ? 2u : 1u);
+          for (char d : name.substr(hex ? 2 : 1)) {
+            int v = isDigit(d) ? d - '0'
+                    : hex && std::isxdigit((unsigned char)d)
+                        ? (std::tolower((unsigned char)d) - 'a' + 10)
+                        : -1;
+            if (v < 0 || cp > 0x10FFFF) {
+              decoded = false;
+              break;
+            }
+            cp = cp * (hex ? 16 : 10) + v;
+          }
+          if (decoded && cp > 0 && cp <= 0x10FFFF) {
+            if (cp < 0x80) {
+              out.push_back(char(cp));
+            } else if (cp < 0x800) {
+              out.push_back(char(0xC0 | (cp >> 6)));
+              out.push_back(char(0x80 | (cp & 0x3F)));
+            } else if (cp < 0x10000) {
+              out.push_back(char(0xE0 | (cp >> 12)));
+              out.push_back(char(0x80 | ((cp >> 6) & 0x3F)));
+              out.push_back(char(0x80 | (cp & 0x3F)));
+            } else {
+              out.push_back(char(0xF0 | (cp >> 18)));
+              out.push_back(char(0x80 | ((cp >> 12) & 0x3F)));
+              out.push_back(char(0x80 | ((cp >> 6) & 0x3F)));
+              out.push_back(char(0x80 | (cp & 0x3F)));
+            }
+          } else {
+            decoded = false;
+          }
+        } else {
+          for (const auto &e : entities) {
+            if (name == e.name) {
+              out.push_back(e.c);
+              decoded = true;
+              break;
+            }
+          }
+        }
+        if (decoded) {
+          i = semi + 1;
+          continue;
+        }
+      }
+    }
+    size_t next = s.find_first_of("& \t\n\r", i + 1);
+    if (next == std::string_view::npos) {
+      next = s.size();
+    }
+    out.append(s.substr(i, next - i));
+    i = next;
+  }
+}
+
+// 解析字幕时间：hh:mm:ss,mmm（SRT）或 [hh:]mm:ss.mmm（WebVTT）
+static bool parseCueTime(std::string_view s, uint32_t &ms) {
+  s = trimView(s);
+  s = s.substr(0, s.find_first_of(ws)); // WebVTT 结束时间后可能有位置设置
+  char buf[16];
+  if (s.empty() || s.size() > sizeof(buf)) {
+    return false;
+  }
+  for (size_t i = 0; i < s.size(); ++i) {
+    buf[i] = s[i] == ',' ? '.' : s[i];
+  }
+  return parseTimeTag(std::string_view(buf, s.size()), ms);
+}
+
+void LyricsBuilder::parseCues(std::string_view content) {
+  bool inCue = false;
+  bool hasEnd = false;
+  uint32_t lastEnd = 0; // 上一条字幕的结束时间
+  size_t pos = 0;
+  while (pos <= content.size()) {
+    size_t end = content.find('\n', pos);
+    if (end == std::string_view::npos) {
+      end = content.size();
+    }
+    std::string_view line = content.substr(pos, end - pos);
+    pos = end + 1;
+    if (!line.empty() && line.back() == '\r') {
+      line.remove_suffix(1);
+    }
+    if (trimView(line).empty()) {
+      if (inCue) {
+        closeLine(); // 空行结束一条字幕
+        inCue = false;
+      }
+      continue;
+    }
+    if (!inCue) {
+      // 序号、cue 标识、WEBVTT 头以及 NOTE/STYLE/REGION 块都没有 "-->"，直接跳过
+      size_t arrow = line.find("-->");
+      uint32_t start = 0, stop = 0;
+      if (arrow == std::string_view::npos ||
+          !parseCueTime(line.substr(0, arrow), start) ||
+          !parseCueTime(line.substr(arrow + 3), stop)) {
+        continue;
+      }
+      if (hasEnd && start > lastEnd) {
+        openLine(lastEnd); // 字幕之间的间隔显示为空行
+        closeLine();
+      }
+      openLine(start);
+      inCue = true;
+      hasEnd = true;
+      // 重叠或乱序的字幕不能让结束时间倒退，否则会在前一条字幕显示期间插入空行
+      lastEnd = std::max({lastEnd, start, stop});
+      continue;
+    }
+    // 字幕文本：多行以空格连接，去除 <i>、<c.xxx>、{\an8} 等样式标签，
+    // WebVTT 的 <hh:mm:ss.mmm> 转为逐字时间戳
+    if (text_.size() > lineStart_) {
+      text_.push_back(' ');
+    }
+    size_t i = 0;
+    while (i < line.size()) {
+      uint32_t wordMs = 0;
+      size_t tagLen = 0;
+      if (line[i] == '<') {
+        if (i + 1 < line.size() && isDigit(line[i + 1]) &&
+            (tagLen = scanTimestamp(line.substr(i), wordMs, '<', '>')) != 0) {
+          markWord(wordMs);
+          i += tagLen;
+          continue;
+        }
+        size_t close = line.find('>', i + 1);
+        if (close != std::string_view::npos) {
+          i = close + 1;
+          continue;
+        }
+      } else if (line[i] == '{' && i + 1 < line.size() && line[i + 1] == '\\') {
+        size_t close = line.find('}', i + 2);
+        if (close != std::string_view::npos) {
+          i = close + 1;
+          continue;
+        }
+      }
+      size_t next = line.find_first_of("<{", i + 1);
+      if (next == std::string_view::npos) {
+        next = line.size();
+      }
+      appendMarkup(text_, lineStart_, line.substr(i, next - i));
+      i = next;
+    }
+  }
+  if (inCue) {
+    closeLine();
+  }
+  if (hasEnd) {
+    openLine(lastEnd); // 最后一条字幕结束后清空显示
+    closeLine();
+  }
+}
+
+// 解析 TTML 时间表达式：时钟时间 hh:mm:ss.fff / mm:ss.fff（Apple 常用），
+// 或偏移时间 12.345s、1500ms、1.5m、1h（省略单位时按秒）
+static bool parseTtmlTime(std::string_view v, uint32_t &ms) {
+  v = trimView(v);
+  if (v.find(':') != std::string_view::npos) {
+    return parseTimeTag(v, ms);
+  }
+  uint64_t whole = 0;
+  uint32_t frac = 0;
+  size_t i = 0, digits = 0;
+  for (; i < v.size() && isDigit(v[i]); ++i) {
+    whole = whole * 10 + (v[i] - '0');
+    if (whole > UINT32_MAX) {
+      return false;
+    }
+  }
+  if (i == 0) {
+    return false;
+  }
+  if (i < v.size() && v[i] == '.') {
+    for (++i; i < v.size() && isDigit(v[i]); ++i, ++digits) {
+      if (digits < 9)
+        frac = frac * 10 + (v[i] - '0');
+    }
+  }
+  const uint32_t fracMs = digits ? fractionToMs(frac, std::min<size_t>(digits, 9)) : 0;
+  std::string_view unit = v.substr(i);
+  uint64_t value;
+  if (unit.empty() || unit == "s") {
+    value = whole * 1000 + fracMs;
+  } else if (unit == "ms") {
+    value = whole;
+  } else if (unit == "m") {
+    value = (whole * 1000 + fracMs) * 60;
+  } else if (unit == "h") {
+    value = (whole * 1000 + fracMs) * 3600;
+  } else {
+    return false; // 帧（f）和节拍（t）需要帧率信息，不支持
+  }
+  if (value > UINT32_MAX) {
+    return false;
+  }
+  ms = static_cast<uint32_t>(value);
+  return true;
+}
+
+// 读取标签中的属性值（name 需完整匹配，如 "begin"、"ttm:role"）
+static std::string_view xmlAttr(std::string_view tag, std::string_view name) {
+  size_t pos = 0;
+  while ((pos = tag.find(name, pos)) != std::string_view::npos) {
+    size_t eq = pos + name.size();
+    bool boundary = pos > 0 && std::isspace((unsigned char)tag[pos - 1]);
+    pos = eq;
+    if (!boundary) {
+      continue;
+    }
+    while (eq < tag.size() && std::isspace((unsigned char)tag[eq]))
+      ++eq;
+    if (eq >= tag.size() || tag[eq] != '=') {
+      continue;
+    }
+    ++eq;
+    while (eq < tag.size() && std::isspace((unsigned char)tag[eq]))
+      ++eq;
+    if (eq >= tag.size() || (tag[eq] != '"' && tag[eq] != '\'')) {
+      continue;
+    }
+    size_t close = tag.find(tag[eq], eq + 1);
+    if (close == std::string_view::npos) {
+      return {};
+    }
+    return tag.substr(eq + 1, close - eq - 1);
+  }
+  return {};
+}
+
+void LyricsBuilder::parseTtml(std::string_view content) {
+  // <p begin end> 为一行，<span begin> 为一个字；ttm:role 为 x-translation /
+  // x-roman 的 span 作为副歌词，其余 span（含 x-bg 和声）按正文处理
+  bool inP = false;
+  bool hasEnd = false;
+  uint32_t lastEnd = 0;
+  std::string sub;
+  std::vector<bool> spans; // 每层 span 是否为副歌词
+  size_t subDepth = 0;     // 当前所在的副歌词 span 层数
+  auto appendTextNode = [&](std::string_view text) {
+    if (!inP) {
+      return;
+    }
+    if (subDepth > 0) {
+      appendMarkup(sub, 0, text);
+    } else {
+      appendMarkup(text_, lineStart_, text);
+    }
+  };
+
+  size_t i = 0;
+  while (i < content.size()) {
+    size_t lt = content.find('<', i);
+    if (lt == std::string_view::npos) {
+      lt = content.size();
+    }
+    appendTextNode(content.substr(i, lt - i));
+    if (lt == content.size()) {
+      break;
+    }
+    std::string_view rest = content.substr(lt);
+    if (rest.starts_with("<!--")) {
+      size_t end = content.find("-->", lt + 4);
+      i = end == std::string_view::npos ? content.size() : end + 3;
+      continue;
+    }
+    if (rest.starts_with("<![CDATA[")) {
+      size_t end = content.find("]]>", lt + 9);
+      size_t stop = end == std::string_view::npos ? content.size() : end;
+      appendTextNode(content.substr(lt + 9, stop - lt - 9));
+      i = end == std::string_view::npos ? content.size() : end + 3;
+      continue;
+    }
+    size_t gt = content.find('>', lt + 1);
+    if (gt == std::string_view::npos) {
+      break;
+    }
+    i = gt + 1;
+    std::string_view tag = content.substr(lt + 1, gt - lt - 1);
+    if (tag.empty() || tag[0] == '?' || tag[0] == '!') {
+      continue;
+    }
+    const bool closing = tag[0] == '/';
+    const bool selfClosing = tag.back() == '/';
+    std::string_view name = tag.substr(closing ? 1 : 0);
+    name = name.substr(0, name.find_first_of(" \t\r\n/"));
+    std::string_view local = name.substr(name.find(':') + 1); // 去除命名空间前缀
+
+    if (local == "head" && !closing && !selfClosing) {
+      // 头部只有样式和元数据，整体跳过
+      std::string close = "</" + std::string(name) + ">";
+      size_t end = content.find(close, i);
+      i = end == std::string_view::npos ? content.size() : end + close.size();
+    } else if (local == "p") {
+      if (closing) {
+        if (inP) {
+          closeLine(trimView(sub));
+          inP = false;
+        }
+        continue;
+      }
+      uint32_t begin = 0, stop = 0;
+      if (inP || !parseTtmlTime(xmlAttr(tag, "begin"), begin)) {
+        continue;
+      }
+      if (hasEnd && begin > lastEnd) {
+        openLine(lastEnd); // 段落之间的间隔显示为空行
+        closeLine();
+      }
+      openLine(begin);
+      inP = !selfClosing;
+      if (!inP) {
+        closeLine();
+      }
+      sub.clear();
+      spans.clear();
+      subDepth = 0;
+      // 没有 end 的段落一直显示到下一段，之后不插入空行；结束时间不倒退
+      hasEnd = parseTtmlTime(xmlAttr(tag, "end"), stop);
+      lastEnd = std::max({lastEnd, begin, hasEnd ? stop : begin});
+    } else if (local == "span" && inP) {
+      if (closing) {
+        if (!spans.empty()) {
+          subDepth -= spans.back();
+          spans.pop_back();
+        }
+        continue;
+      }
+      std::string_view role = xmlAttr(tag, "ttm:role");
+      const bool isSub = role == "x-translation" || role == "x-roman";
+      uint32_t begin = 0;
+      if (!isSub && subDepth == 0 && parseTtmlTime(xmlAttr(tag, "begin"), begin)) {
+        markWord(begin);
+      }
+      if (!selfClosing) {
+        spans.push_back(isSub);
+        subDepth += isSub;
+      }
+    } else if (local == "br" && inP) {
+      appendTextNode(" ");
+    }
+  }
+  if (inP) {
+    closeLine(trimView(sub));
+  }
+  if (hasEnd) {
+    openLine(lastEnd); // 最后一段结束后清空显示
+    closeLine();
+  }
+}
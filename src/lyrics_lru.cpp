@@ -0,0 +1,92 @@
+#include "../include/lyrics_lru.h"
+#include "common.h"
+#include <algorithm>
+#include <cinttypes>
+
+// 未配置 cache_memory_kb 时的默认预算
+static constexpr size_t kDefaultBudget = 4 * 1024 * 1024;
+
+LyricsLru &LyricsLru::shared() {
+  static LyricsLru lru(kDefaultBudget);
+  return lru;
+}
+
+size_t LyricsLru::costOf(const std::string &key, const LyricsDocument &lyrics) {
+  // 文档 arena 加上 key 和节点的大致开销
+  return lyrics.byteSize() + key.size() + sizeof(Entry) + 64;
+}
+
+std::shared_ptr<const LyricsDocument> LyricsLru::get(const std::string &key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = map_.find(key);
+  if (it == map_.end()) {
+    ++misses_;
+    return nullptr;
+  }
+  ++hits_;
+  entries_.splice(entries_.begin(), entries_, it->second); // 移到头部
+  return it->second->lyrics;
+}
+
+void LyricsLru::put(const std::string &key,
+                    std::shared_ptr<const LyricsDocument> lyrics) {
+  if (!lyrics) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  const size_t bytes = costOf(key, *lyrics);
+  auto it = map_.find(key);
+  if (it != map_.end()) {
+    bytes_ -= it->second->bytes;
+    it->second->lyrics = std::move(lyrics);
+    it->second->bytes = bytes;
+    entries_.splice(entries_.begin(), entries_, it->second);
+  } else {
+    entries_.push_front({key, std::move(lyrics), bytes});
+    map_.emplace(key, entries_.begin());
+  }
+  bytes_ += bytes;
+  evict();
+}
+
+void LyricsLru::requestBudget(size_t budgetBytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const size_t budget = budgetRequested_ ? std::max(budget_, budgetBytes) : budgetBytes;
+  if (budgetRequested_ && budget != budgetBytes) {
+    DEBUG("  >> Lyrics LRU budget stays at %zu bytes (requested %zu)", budget,
+          budgetBytes);
+  }
+  budgetRequested_ = true;
+  budget_ = budget;
+  evict();
+}
+
+void LyricsLru::evict() {
+  // 从尾部（最久未使用）开始淘汰；仍在使用（如正在显示）的文档跳过，
+  // 淘汰它也不会释放内存，只会让下次查找失效
+  auto it = entries_.end();
+  while (bytes_ > budget_ && it != entries_.begin()) {
+    --it;
+    if (it->lyrics.use_count() > 1) {
+      continue;
+    }
+    bytes_ -= it->bytes;
+    map_.erase(it->key);
+    it = entries_.erase(it);
+    ++evictions_;
+  }
+}
+
+LyricsLru::Stats LyricsLru::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return {hits_, misses_, evictions_, entries_.size(), bytes_, budget_};
+}
+
+void LyricsLru::logStats() const {
+  const Stats s = stats();
+  const uint64_t total = s.hits + s.misses;
+  INFO("  >> Lyrics LRU: hits=%" PRIu64 " misses=%" PRIu64
+       " (hit rate %.1f%%) evictions=%" PRIu64 " entries=%zu bytes=%zu/%zu",
+       s.hits, s.misses, total ? 100.0 * s.hits / total : 0.0, s.evictions,
+       s.entries, s.bytes, s.budget);
+}
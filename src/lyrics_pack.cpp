@@ -0,0 +1,1031 @@
+#include "../include/lyrics_pack.h"
+#include "../include/utils.hpp"
+#include "common.h"
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstddef>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+// 文件格式（本机字节序，缓存只在本机使用）：
+//   lyrics.pack：[PackHeader][记录]...，每条记录为
+//                [RecordHeader][key][对齐][数据][对齐]，8 字节对齐；
+//                数据为 [uint32 源文本长度][源文本][对齐][LyricsDocument 编译数据]
+//                （早期没有 kRecordHasSource 标志的记录只有编译数据）
+//   lyrics.idx ：[IndexHeader][IndexSlot × capacity]，线性探测，keyHash 为 0 表示空槽
+static constexpr uint32_t kPackMagic = 0x4b504c57;   // "WLPK"
+static constexpr uint32_t kIndexMagic = 0x58494c57;  // "WLIX"
+static constexpr uint32_t kRecordMagic = 0x52524c57; // "WLRR"
+static constexpr uint16_t kPackVersion = 1;
+static constexpr uint32_t kInitialCapacity = 1024; // 初始槽数（2 的幂）
+
+struct PackHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t reserved;
+  uint64_t generation; // 压缩代数，每次压缩加一；索引的代数相同时其中的偏移才有效
+};
+
+struct RecordHeader {
+  uint32_t magic;
+  uint32_t keyLength;
+  uint64_t keyHash;
+  uint32_t dataSize; // 编译数据字节数
+  uint32_t flags;     // 低 8 位为歌词来源（LyricsSource），高 20 位为歌曲时长（秒）
+  int64_t storedAt;  // 写入时间（Unix 秒）
+};
+static constexpr uint32_t kSourceMask = 0xff;
+// 数据中带有源文本：编译格式（kLyricsVersion）升级后从源文本重新编译，缓存不会失效
+static constexpr uint32_t kRecordHasSource = 1u << 8;
+// 歌曲时长（秒，0 表示未知）：key 中不含时长，查到后与播放器报告的时长比较
+static constexpr uint32_t kLengthShift = 12;
+static constexpr uint32_t kMaxLengthSeconds = (1u << (32 - kLengthShift)) - 1;
+
+static uint32_t lengthFlags(int64_t lengthMs) {
+  const int64_t seconds = lengthMs > 0 ? (lengthMs + 500) / 1000 : 0;
+  return static_cast<uint32_t>(std::min<int64_t>(seconds, kMaxLengthSeconds))
+         << kLengthShift;
+}
+
+// 来源优先级：播放器提供的歌词与播放的内容一致，优先于网络查询和导入的结果
+static int sourcePriority(LyricsSource source) {
+  return source == LyricsSource::Player ? 1 : 0;
+}
+
+struct IndexHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t reserved;
+  uint32_t capacity;
+  uint32_t count;
+  uint64_t generation; // 对应的 pack 的压缩代数
+};
+
+struct IndexSlot {
+  uint64_t keyHash;
+  uint64_t offset; // 记录在 pack 中的偏移
+};
+
+static size_t align8(size_t n) { return (n + 7) & ~size_t(7); }
+
+// 0 保留给空槽
+static uint64_t keyHashOf(std::string_view key) {
+  uint64_t h = hash64(key);
+  return h ? h : 1;
+}
+
+// 只读映射整个文件，munmap 由最后一个持有者负责
+static std::shared_ptr<const void> mapFile(int fd, size_t size) {
+  void *addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED) {
+    return nullptr;
+  }
+  return std::shared_ptr<const void>(
+      addr, [size](const void *p) { munmap(const_cast<void *>(p), size); });
+}
+
+// 映射内存中一条记录的各部分
+struct RecordView {
+  RecordHeader header;
+  std::string_view key;
+  std::string_view source; // 源文本（早期记录没有）
+  const std::byte *image;  // 编译数据
+  size_t imageSize;
+  uint64_t size; // 含对齐的记录总字节数
+};
+
+// 解析 offset 处的记录，只校验边界（不校验 key 的哈希）
+static bool viewRecord(const std::byte *base, uint64_t size, uint64_t offset,
+                       RecordView &out) {
+  if (offset + sizeof(RecordHeader) > size) {
+    return false;
+  }
+  RecordHeader &r = out.header;
+  std::memcpy(&r, base + offset, sizeof(r));
+  if (r.magic != kRecordMagic) {
+    return false;
+  }
+  const uint64_t keyAt = offset + sizeof(r);
+  const uint64_t dataAt = align8(keyAt + r.keyLength);
+  out.size = align8(dataAt + uint64_t(r.dataSize)) - offset;
+  if (offset + out.size > size) {
+    return false;
+  }
+  out.key = std::string_view(reinterpret_cast<const char *>(base + keyAt), r.keyLength);
+  uint64_t imageAt = dataAt;
+  out.source = {};
+  if (r.flags & kRecordHasSource) {
+    uint32_t sourceSize;
+    if (r.dataSize < sizeof(sourceSize)) {
+      return false;
+    }
+    std::memcpy(&sourceSize, base + dataAt, sizeof(sourceSize));
+    const uint64_t prefix = align8(sizeof(sourceSize) + uint64_t(sourceSize));
+    if (prefix > r.dataSize) {
+      return false;
+    }
+    out.source = std::string_view(
+        reinterpret_cast<const char *>(base + dataAt + sizeof(sourceSize)), sourceSize);
+    imageAt += prefix;
+  }
+  out.image = base + imageAt;
+  out.imageSize = dataAt + r.dataSize - imageAt;
+  return true;
+}
+
+static bool writeAll(int fd, const void *data, size_t size, uint64_t offset) {
+  const char *p = static_cast<const char *>(data);
+  while (size > 0) {
+    ssize_t n = pwrite(fd, p, size, offset);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    p += n;
+    size -= n;
+    offset += n;
+  }
+  return true;
+}
+
+static bool readAll(int fd, void *data, size_t size, uint64_t offset) {
+  char *p = static_cast<char *>(data);
+  while (size > 0) {
+    ssize_t n = pread(fd, p, size, offset);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    p += n;
+    size -= n;
+    offset += n;
+  }
+  return true;
+}
+
+// 写入完整的索引文件（新建或扩容后）
+static bool writeIndex(int fd, const std::vector<IndexSlot> &slots,
+                       uint32_t count, uint64_t generation) {
+  IndexHeader h{kIndexMagic, kPackVersion, 0,
+                static_cast<uint32_t>(slots.size()), count, generation};
+  return writeAll(fd, &h, sizeof(h), 0) &&
+         writeAll(fd, slots.data(), slots.size() * sizeof(IndexSlot),
+                  sizeof(h));
+}
+
+// 放入新建的索引（各记录的 key 互不相同，哈希相同时也各占一个槽）
+static void placeSlot(std::vector<IndexSlot> &slots, IndexSlot slot) {
+  const size_t mask = slots.size() - 1;
+  size_t i = slot.keyHash & mask;
+  while (slots[i].keyHash != 0) {
+    i = (i + 1) & mask;
+  }
+  slots[i] = slot;
+}
+
+// 扫描 pack 中的所有记录重建索引（索引丢失或损坏时），同一 key 以最后写入的记录为准；
+// 返回记录数
+static uint32_t scanPack(int packFd, std::vector<IndexSlot> &slots) {
+  std::unordered_map<std::string_view, uint64_t> latest; // key → 偏移
+  struct stat st;
+  std::shared_ptr<const void> mapping;
+  if (fstat(packFd, &st) == 0 && static_cast<uint64_t>(st.st_size) > sizeof(PackHeader)) {
+    mapping = mapFile(packFd, st.st_size);
+  }
+  if (mapping) {
+    auto *base = static_cast<const std::byte *>(mapping.get());
+    const uint64_t size = st.st_size;
+    for (uint64_t offset = sizeof(PackHeader); offset + sizeof(RecordHeader) <= size;) {
+      RecordView rec;
+      if (viewRecord(base, size, offset, rec) && rec.header.keyHash == keyHashOf(rec.key)) {
+        latest[rec.key] = offset;
+        offset += rec.size;
+      } else {
+        offset += 8; // 写入中断留下的残缺数据，按 8 字节对齐寻找下一条记录
+      }
+    }
+  }
+  size_t capacity = kInitialCapacity;
+  while (latest.size() * 2 > capacity) {
+    capacity *= 2;
+  }
+  slots.assign(capacity, IndexSlot{});
+  for (const auto &[key, offset] : latest) {
+    placeSlot(slots, {keyHashOf(key), offset});
+  }
+  return static_cast<uint32_t>(latest.size());
+}
+
+LyricsPack::LyricsPack(const std::filesystem::path &dir)
+    : packPath_(dir / "lyrics.pack"), indexPath_(dir / "lyrics.idx"),
+      lockPath_(dir / "lyrics.lock"), hitsPath_(dir / "lyrics.hits") {
+  std::error_code ec;
+  std::filesystem::create_directories(dir, ec);
+}
+
+LyricsPack::~LyricsPack() { flushAccessLog(); }
+
+bool LyricsPack::refreshIndex() {
+  int fd = open(indexPath_.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  IndexHeader h;
+  bool ok = false;
+  if (fstat(fd, &st) != 0) {
+    ok = false;
+  } else if (index_ && static_cast<uint64_t>(st.st_ino) == indexInode_) {
+    ok = true; // 仍是同一个文件，槽位的原地更新通过 MAP_SHARED 可见
+  } else if (pread(fd, &h, sizeof(h), 0) == sizeof(h) &&
+             h.magic == kIndexMagic && h.version == kPackVersion &&
+             h.capacity != 0 && (h.capacity & (h.capacity - 1)) == 0 &&
+             static_cast<uint64_t>(st.st_size) >=
+                 sizeof(h) + uint64_t(h.capacity) * sizeof(IndexSlot)) {
+    if (auto mapping = mapFile(fd, st.st_size)) {
+      saveHits(); // 旧索引槽位上的命中时间
+      index_ = std::move(mapping);
+      indexInode_ = st.st_ino;
+      indexCapacity_ = h.capacity;
+      indexGeneration_ = h.generation;
+      accessed_.assign(h.capacity, 0);
+      ok = true;
+      mapPack(); // 索引被替换时 pack 可能也已被压缩替换
+    }
+  }
+  close(fd);
+  return ok;
+}
+
+bool LyricsPack::mapPack() {
+  int fd = open(packPath_.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  bool ok = false;
+  if (fstat(fd, &st) == 0 && st.st_size > 0 &&
+      ((size_t)st.st_size > packSize_ ||
+       static_cast<uint64_t>(st.st_ino) != packInode_)) {
+    if (auto mapping = mapFile(fd, st.st_size)) {
+      // 旧映射由仍在使用的文档继续持有
+      pack_ = std::move(mapping);
+      packSize_ = st.st_size;
+      packInode_ = st.st_ino;
+      PackHeader ph{};
+      if (packSize_ >= sizeof(ph)) {
+        std::memcpy(&ph, pack_.get(), sizeof(ph));
+      }
+      packGeneration_ = ph.magic == kPackMagic ? ph.generation : 0;
+      ok = true;
+    }
+  }
+  close(fd);
+  return ok;
+}
+
+bool LyricsPack::sameGeneration() {
+  // 压缩依次替换 pack 和索引，两次 rename 之间新 pack 与旧索引不一致，按未命中处理
+  return packGeneration_ == indexGeneration_ ||
+         (mapPack() && packGeneration_ == indexGeneration_);
+}
+
+void LyricsPack::saveHits() {
+  if (!index_) {
+    return;
+  }
+  auto *slots = reinterpret_cast<const IndexSlot *>(
+      static_cast<const std::byte *>(index_.get()) + sizeof(IndexHeader));
+  for (uint32_t i = 0; i < accessed_.size(); ++i) {
+    if (accessed_[i] != 0) {
+      pendingHits_.emplace_back(slots[i].keyHash, accessed_[i]);
+      accessed_[i] = 0;
+    }
+  }
+}
+
+std::shared_ptr<const LyricsDocument>
+LyricsPack::readRecord(uint64_t offset, std::string_view key, uint64_t hash,
+                       RecordInfo *info) {
+  RecordView rec;
+  auto view = [&] {
+    return pack_ && viewRecord(static_cast<const std::byte *>(pack_.get()), packSize_,
+                               offset, rec);
+  };
+  // 其他进程追加的记录可能超出当前映射范围
+  if (!view() && (!mapPack() || !view())) {
+    return nullptr;
+  }
+  if (rec.header.keyHash != hash || rec.key != key) {
+    return nullptr;
+  }
+  if (info) {
+    info->storedAt = rec.header.storedAt;
+    info->source = static_cast<LyricsSource>(rec.header.flags & kSourceMask);
+    info->lengthMs = int64_t(rec.header.flags >> kLengthShift) * 1000;
+  }
+  auto lyrics = LyricsDocument::fromImage(pack_, rec.image, rec.imageSize);
+  if (!lyrics && !rec.source.empty()) {
+    // 编译格式已升级（或编译数据损坏）：从源文本重新编译
+    lyrics = LyricsDocument::parse(rec.source);
+  }
+  return lyrics;
+}
+
+std::shared_ptr<const LyricsDocument>
+LyricsPack::lookup(std::string_view key, uint64_t hash, RecordInfo *info) {
+  if (!index_ || !sameGeneration()) {
+    return nullptr;
+  }
+  auto *slots = reinterpret_cast<const IndexSlot *>(
+      static_cast<const std::byte *>(index_.get()) + sizeof(IndexHeader));
+  const uint32_t mask = indexCapacity_ - 1;
+  for (uint32_t i = hash & mask, n = 0; n < indexCapacity_; i = (i + 1) & mask, ++n) {
+    const uint64_t slotHash = slots[i].keyHash;
+    if (slotHash == 0) {
+      return nullptr;
+    }
+    if (slotHash == hash) {
+      if (auto lyrics = readRecord(slots[i].offset, key, hash, info)) {
+        accessed_[i] = static_cast<uint32_t>(std::time(nullptr)); // 压缩时的淘汰依据
+        return lyrics;
+      }
+      // 哈希相同但 key 不同，继续探测
+    }
+  }
+  return nullptr;
+}
+
+std::shared_ptr<const LyricsDocument> LyricsPack::find(std::string_view key,
+                                                       RecordInfo *info) {
+  const uint64_t hash = keyHashOf(key);
+  std::lock_guard<std::mutex> lock(mutex_);
+  // 命中时只访问映射内存；未命中时才检查索引是否已被其他进程重建
+  auto lyrics = lookup(key, hash, info);
+  if (!lyrics) {
+    const uint64_t inode = indexInode_;
+    if (refreshIndex() && indexInode_ != inode) {
+      lyrics = lookup(key, hash, info);
+    }
+  }
+  return lyrics;
+}
+
+size_t LyricsPack::size() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!refreshIndex()) {
+    return 0;
+  }
+  IndexHeader h;
+  std::memcpy(&h, index_.get(), sizeof(h));
+  return h.count;
+}
+
+template <typename Fn> void LyricsPack::forEachRecord(Fn &&fn) {
+  if (!sameGeneration()) {
+    return;
+  }
+  auto *slots = reinterpret_cast<const IndexSlot *>(
+      static_cast<const std::byte *>(index_.get()) + sizeof(IndexHeader));
+  for (uint32_t i = 0; i < indexCapacity_; ++i) {
+    const uint64_t hash = slots[i].keyHash, offset = slots[i].offset;
+    if (hash == 0) {
+      continue;
+    }
+    RecordView rec;
+    auto view = [&] {
+      return pack_ && viewRecord(static_cast<const std::byte *>(pack_.get()),
+                                 packSize_, offset, rec);
+    };
+    if ((view() || (mapPack() && view())) && rec.header.keyHash == hash) {
+      fn(rec);
+    }
+  }
+}
+
+std::vector<std::string> LyricsPack::keys() {
+  std::vector<std::string> keys;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!refreshIndex()) {
+    return keys;
+  }
+  forEachRecord([&keys](const RecordView &rec) { keys.emplace_back(rec.key); });
+  return keys;
+}
+
+std::vector<std::string> LyricsPack::sources() {
+  std::vector<std::string> sources;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!refreshIndex()) {
+    return sources;
+  }
+  forEachRecord([this, &sources](const RecordView &rec) {
+    if (!rec.source.empty()) {
+      sources.emplace_back(rec.source);
+    } else if (auto lyrics = LyricsDocument::fromImage(pack_, rec.image, rec.imageSize)) {
+      sources.push_back(lyrics->toLrc());
+    }
+  });
+  return sources;
+}
+
+bool LyricsPack::insert(std::string_view key, const LyricsDocument &lyrics,
+                        LyricsSource source, std::string_view sourceText) {
+  std::string lrc;
+  if (sourceText.empty()) {
+    lrc = lyrics.toLrc();
+    sourceText = lrc;
+  }
+  const PendingRecord record{key, keyHashOf(key), &lyrics, source, sourceText, 0};
+  return insertBatch({&record, 1}, false);
+}
+
+bool LyricsPack::insert(const std::vector<Write> &batch, bool sync) {
+  // 源文本在加锁前生成
+  std::vector<std::string> texts;
+  texts.reserve(batch.size());
+  for (const auto &w : batch) {
+    texts.push_back(w.lyrics ? w.lyrics->toLrc() : std::string());
+  }
+  std::vector<PendingRecord> records;
+  records.reserve(batch.size());
+  for (size_t i = 0; i < batch.size(); ++i) {
+    const auto &w = batch[i];
+    if (w.lyrics) {
+      records.push_back(
+          {w.key, keyHashOf(w.key), w.lyrics.get(), w.source, texts[i], w.lengthMs});
+    }
+  }
+  return records.empty() || insertBatch(records, sync);
+}
+
+template <typename Fn> bool LyricsPack::withFileLock(Fn &&fn) {
+  int lockFd = open(lockPath_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (lockFd < 0) {
+    ERROR("  >> Failed to open cache lock: %s", lockPath_.c_str());
+    return false;
+  }
+  // flock 作用于打开的文件描述，同一进程内的多个线程之间同样互斥
+  bool ok = false;
+  if (flock(lockFd, LOCK_EX) == 0) {
+    ok = fn();
+    flock(lockFd, LOCK_UN);
+  }
+  close(lockFd);
+  return ok;
+}
+
+bool LyricsPack::insertBatch(std::span<const PendingRecord> records, bool sync) {
+  return withFileLock([&] { return insertLocked(records, sync); });
+}
+
+bool LyricsPack::touch(std::string_view key) {
+  return withFileLock([&] { return touchLocked(key); });
+}
+
+bool LyricsPack::touchLocked(std::string_view key) {
+  int packFd = open(packPath_.c_str(), O_RDWR | O_CLOEXEC);
+  int idxFd = open(indexPath_.c_str(), O_RDONLY | O_CLOEXEC);
+  PackHeader ph{};
+  IndexHeader h{};
+  bool ok = packFd >= 0 && idxFd >= 0 && readAll(packFd, &ph, sizeof(ph), 0) &&
+            ph.magic == kPackMagic && readAll(idxFd, &h, sizeof(h), 0) &&
+            h.magic == kIndexMagic && h.version == kPackVersion && h.capacity != 0 &&
+            (h.capacity & (h.capacity - 1)) == 0 && h.generation == ph.generation;
+  bool found = false;
+  if (ok) {
+    // 按索引探测（与 lookup 相同），每个槽和记录头都用 pread 读取
+    const uint64_t hash = keyHashOf(key);
+    const uint32_t mask = h.capacity - 1;
+    std::string stored(key.size(), '\0');
+    for (uint32_t i = hash & mask, n = 0; n < h.capacity; i = (i + 1) & mask, ++n) {
+      IndexSlot slot;
+      if (!readAll(idxFd, &slot, sizeof(slot), sizeof(h) + uint64_t(i) * sizeof(slot)) ||
+          slot.keyHash == 0) {
+        break;
+      }
+      RecordHeader r;
+      if (slot.keyHash != hash || !readAll(packFd, &r, sizeof(r), slot.offset) ||
+          r.magic != kRecordMagic || r.keyHash != hash || r.keyLength != key.size() ||
+          !readAll(packFd, stored.data(), stored.size(), slot.offset + sizeof(r)) ||
+          stored != key) {
+        continue;
+      }
+      const int64_t now = std::time(nullptr);
+      found = writeAll(packFd, &now, sizeof(now),
+                       slot.offset + offsetof(RecordHeader, storedAt));
+      break;
+    }
+  }
+  if (packFd >= 0) {
+    close(packFd);
+  }
+  if (idxFd >= 0) {
+    close(idxFd);
+  }
+  return found;
+}
+
+bool LyricsPack::insertLocked(std::span<const PendingRecord> records, bool sync) {
+  int packFd = open(packPath_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (packFd < 0) {
+    ERROR("  >> Failed to open lyrics pack: %s", packPath_.c_str());
+    return false;
+  }
+  int idxFd = open(indexPath_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (idxFd < 0) {
+    ERROR("  >> Failed to open lyrics index: %s", indexPath_.c_str());
+    close(packFd);
+    return false;
+  }
+  // 索引与 pack 的压缩代数不同（压缩在两次 rename 之间中断）时按损坏处理
+  PackHeader ph{};
+  const bool hasHeader = readAll(packFd, &ph, sizeof(ph), 0) && ph.magic == kPackMagic;
+  const uint64_t generation = hasHeader ? ph.generation : 0;
+  IndexHeader h{};
+  std::vector<IndexSlot> slots;
+  bool valid = pread(idxFd, &h, sizeof(h), 0) == sizeof(h) &&
+               h.magic == kIndexMagic && h.version == kPackVersion &&
+               h.capacity != 0 && (h.capacity & (h.capacity - 1)) == 0 &&
+               h.capacity <= (1u << 24) && hasHeader && h.generation == generation;
+  if (valid) {
+    slots.resize(h.capacity);
+    const size_t bytes = slots.size() * sizeof(IndexSlot);
+    valid = pread(idxFd, slots.data(), bytes, sizeof(h)) == (ssize_t)bytes;
+  }
+  if (!valid) {
+    // 新建索引，或索引丢失/损坏后扫描 pack 重建，已有记录仍然可以找到
+    h.count = scanPack(packFd, slots);
+    if (h.count > 0) {
+      INFO("  >> Rebuilt lyrics index from %u records in %s", h.count,
+           packPath_.c_str());
+    }
+  }
+  const size_t mask = slots.size() - 1;
+  // 哈希相同时还要比较 key：不同 key 的哈希碰撞各占一个槽
+  auto sameKey = [packFd](uint64_t offset, std::string_view key) {
+    RecordHeader r;
+    std::string stored(key.size(), '\0');
+    return readAll(packFd, &r, sizeof(r), offset) && r.keyLength == key.size() &&
+           readAll(packFd, stored.data(), stored.size(), offset + sizeof(r)) &&
+           stored == key;
+  };
+  auto slotOf = [&slots, mask, &sameKey](uint64_t hash, std::string_view key) {
+    size_t i = hash & mask;
+    while (slots[i].keyHash != 0 &&
+           (slots[i].keyHash != hash || !sameKey(slots[i].offset, key))) {
+      i = (i + 1) & mask;
+    }
+    return i;
+  };
+
+  // 1. 追加记录：整批记录一次写入，先写数据再发布索引，
+  //    读者看到槽位时记录已经完整，中途崩溃只会留下未被索引的残缺数据
+  struct stat st;
+  if (fstat(packFd, &st) != 0) {
+    close(packFd);
+    close(idxFd);
+    return false;
+  }
+  uint64_t end = st.st_size;
+  if (end < sizeof(PackHeader)) {
+    ph = {kPackMagic, kPackVersion, 0, generation};
+    if (!writeAll(packFd, &ph, sizeof(ph), 0)) {
+      close(packFd);
+      close(idxFd);
+      return false;
+    }
+    end = sizeof(ph);
+  }
+  const uint64_t start = align8(end); // 上次写入中断时跳过残缺部分
+  std::vector<IndexSlot> published;
+  std::vector<std::string_view> publishedKeys;
+  published.reserve(records.size());
+  publishedKeys.reserve(records.size());
+  std::vector<std::byte> buffer;
+  const int64_t now = std::time(nullptr);
+  for (const auto &rec : records) {
+    // 来源优先级：已有更高优先级来源的记录时不覆盖（例如网络结果不覆盖播放器提供的歌词）
+    const IndexSlot &existing = slots[slotOf(rec.hash, rec.key)];
+    RecordHeader old;
+    if (existing.keyHash == rec.hash &&
+        pread(packFd, &old, sizeof(old), existing.offset) == sizeof(old) &&
+        old.magic == kRecordMagic && old.keyHash == rec.hash &&
+        sourcePriority(static_cast<LyricsSource>(old.flags & kSourceMask)) >
+            sourcePriority(rec.source)) {
+      DEBUG("  >> Keeping cached lyrics from a preferred source: %.*s",
+            (int)rec.key.size(), rec.key.data());
+      continue;
+    }
+    const size_t at = buffer.size();
+    const size_t dataAt = align8(sizeof(RecordHeader) + rec.key.size());
+    const uint32_t sourceSize = static_cast<uint32_t>(rec.sourceText.size());
+    const size_t imageAt = dataAt + align8(sizeof(sourceSize) + sourceSize);
+    buffer.resize(at + align8(imageAt + rec.lyrics->byteSize()));
+    RecordHeader r{kRecordMagic, static_cast<uint32_t>(rec.key.size()), rec.hash,
+                   static_cast<uint32_t>(imageAt - dataAt + rec.lyrics->byteSize()),
+                   static_cast<uint32_t>(rec.source) | kRecordHasSource |
+                       lengthFlags(rec.lengthMs),
+                   now};
+    std::memcpy(buffer.data() + at, &r, sizeof(r));
+    std::memcpy(buffer.data() + at + sizeof(r), rec.key.data(), rec.key.size());
+    std::memcpy(buffer.data() + at + dataAt, &sourceSize, sizeof(sourceSize));
+    std::memcpy(buffer.data() + at + dataAt + sizeof(sourceSize), rec.sourceText.data(),
+                sourceSize);
+    std::memcpy(buffer.data() + at + imageAt, rec.lyrics->data(),
+                rec.lyrics->byteSize());
+    published.push_back({rec.hash, start + at});
+    publishedKeys.push_back(rec.key);
+  }
+  // sync 时先让数据落盘再发布索引，掉电后索引不会指向未写完的记录
+  const bool written = writeAll(packFd, buffer.data(), buffer.size(), start) &&
+                       (!sync || fdatasync(packFd) == 0);
+  if (!written || published.empty()) {
+    if (!written) {
+      ERROR("  >> Failed to append to lyrics pack: %s", packPath_.c_str());
+    }
+    close(packFd);
+    close(idxFd);
+    return written;
+  }
+
+  // 2. 更新索引：统计新增的 key（已有记录只替换偏移，旧记录留在 pack 中等待压缩）
+  std::vector<size_t> positions;
+  positions.reserve(published.size());
+  uint32_t count = h.count;
+  for (size_t n = 0; n < published.size(); ++n) {
+    const IndexSlot &slot = published[n];
+    const size_t i = slotOf(slot.keyHash, publishedKeys[n]);
+    count += slots[i].keyHash == 0;
+    slots[i] = slot;
+    positions.push_back(i);
+  }
+  bool ok;
+  if (!valid || size_t(count) * 2 > slots.size()) {
+    // 新建索引或负载超过 1/2（容量翻倍）：写入临时文件后 rename 原子替换，
+    // 不截断其他进程正在映射的文件；它们在下次未命中时重新映射
+    size_t capacity = slots.size();
+    while (size_t(count) * 2 > capacity) {
+      capacity *= 2;
+    }
+    std::vector<IndexSlot> grown(capacity);
+    for (const auto &s : slots) {
+      if (s.keyHash != 0) {
+        placeSlot(grown, s);
+      }
+    }
+    const auto tmpPath = uniqueTmpPath(indexPath_);
+    int tmpFd = open(tmpPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    ok = tmpFd >= 0 && writeIndex(tmpFd, grown, count, generation) &&
+         (!sync || fdatasync(tmpFd) == 0);
+    if (tmpFd >= 0) {
+      close(tmpFd);
+    }
+    ok = ok && rename(tmpPath.c_str(), indexPath_.c_str()) == 0;
+    if (!ok) {
+      unlink(tmpPath.c_str());
+    }
+  } else {
+    // 先写偏移再写哈希：读者看到哈希时偏移已经有效
+    ok = true;
+    for (size_t i : positions) {
+      const uint64_t at = sizeof(h) + i * sizeof(IndexSlot);
+      ok = ok &&
+           writeAll(idxFd, &slots[i].offset, sizeof(uint64_t),
+                    at + offsetof(IndexSlot, offset)) &&
+           writeAll(idxFd, &slots[i].keyHash, sizeof(uint64_t), at);
+    }
+    ok = ok && writeAll(idxFd, &count, sizeof(count), offsetof(IndexHeader, count)) &&
+         (!sync || fdatasync(idxFd) == 0);
+  }
+  close(packFd); // 查找槽位时需要读取记录的 key
+  close(idxFd);
+  if (!ok) {
+    ERROR("  >> Failed to update lyrics index: %s", indexPath_.c_str());
+  }
+  return ok;
+}
+
+// lyrics.hits：[HitRecord]...，记录最近的命中时间，后写入的覆盖先写入的
+struct HitRecord {
+  uint64_t keyHash;
+  int64_t accessedAt; // Unix 秒
+};
+
+// 压缩时的单条有效记录
+struct LiveRecord {
+  uint64_t keyHash;
+  uint64_t offset;
+  uint64_t size;   // 含对齐的记录总字节数
+  int64_t lastUse; // max(写入时间, 最近命中时间)
+};
+
+// 写入临时文件后 rename 替换
+static bool replaceFile(const std::filesystem::path &path, const void *data,
+                        size_t size) {
+  const auto tmpPath = uniqueTmpPath(path);
+  int fd = open(tmpPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  bool ok = writeAll(fd, data, size, 0) && fdatasync(fd) == 0;
+  close(fd);
+  ok = ok && rename(tmpPath.c_str(), path.c_str()) == 0;
+  if (!ok) {
+    unlink(tmpPath.c_str());
+  }
+  return ok;
+}
+
+void LyricsPack::flushAccessLog() {
+  std::vector<HitRecord> hits;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    saveHits();
+    hits.reserve(pendingHits_.size());
+    for (const auto &[hash, at] : pendingHits_) {
+      hits.push_back({hash, at});
+    }
+    pendingHits_.clear();
+  }
+  if (hits.empty()) {
+    return;
+  }
+  int fd = open(hitsPath_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return;
+  }
+  writeAll(fd, hits.data(), hits.size() * sizeof(HitRecord));
+  close(fd);
+}
+
+bool LyricsPack::compact(uint64_t maxBytes, std::stop_token stop) {
+  const auto start = std::chrono::steady_clock::now();
+  flushAccessLog(); // 本进程的命中时间与其他进程的一起参与淘汰
+  Stats result;
+  if (!withFileLock([&] { return compactLocked(maxBytes, stop, result); })) {
+    return false;
+  }
+  result.lastCompactionMs = std::chrono::duration<double, std::milli>(
+                                std::chrono::steady_clock::now() - start)
+                                .count();
+  std::lock_guard<std::mutex> lock(mutex_);
+  result.compactions = lastCompaction_.compactions + 1;
+  lastCompaction_ = result;
+  refreshIndex(); // 切换到新文件，旧映射由仍在使用的文档继续持有
+  INFO("  >> Lyrics pack compacted in %.1f ms: %zu entries kept, %zu evicted, "
+       "%" PRIu64 " bytes reclaimed",
+       result.lastCompactionMs, result.entries, result.lastEvicted,
+       result.lastReclaimed);
+  return true;
+}
+
+bool LyricsPack::compactLocked(uint64_t maxBytes, std::stop_token stop,
+                               Stats &result) {
+  int packFd = open(packPath_.c_str(), O_RDONLY | O_CLOEXEC);
+  int idxFd = open(indexPath_.c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat packSt{}, idxSt{};
+  PackHeader ph{};
+  IndexHeader h{};
+  std::vector<IndexSlot> slots;
+  // 索引属于另一代时不压缩，下次写入时重建索引
+  bool valid = packFd >= 0 && idxFd >= 0 && fstat(packFd, &packSt) == 0 &&
+               fstat(idxFd, &idxSt) == 0 &&
+               readAll(packFd, &ph, sizeof(ph), 0) && ph.magic == kPackMagic &&
+               readAll(idxFd, &h, sizeof(h), 0) && h.magic == kIndexMagic &&
+               h.version == kPackVersion && h.capacity != 0 &&
+               (h.capacity & (h.capacity - 1)) == 0 && h.capacity <= (1u << 24) &&
+               h.generation == ph.generation;
+  if (valid) {
+    slots.resize(h.capacity);
+    valid = readAll(idxFd, slots.data(), slots.size() * sizeof(IndexSlot),
+                    sizeof(h));
+  }
+  if (idxFd >= 0) {
+    close(idxFd);
+  }
+  if (!valid) {
+    if (packFd >= 0) {
+      close(packFd);
+    }
+    return false;
+  }
+  const uint64_t packSize = packSt.st_size;
+
+  // 1. 收集索引引用的有效记录
+  std::vector<LiveRecord> live;
+  live.reserve(h.count);
+  std::unordered_map<uint64_t, size_t> byHash;
+  uint64_t liveBytes = 0;
+  for (const auto &slot : slots) {
+    RecordHeader r;
+    if (slot.keyHash == 0 || slot.offset + sizeof(r) > packSize ||
+        !readAll(packFd, &r, sizeof(r), slot.offset) ||
+        r.magic != kRecordMagic || r.keyHash != slot.keyHash) {
+      continue;
+    }
+    const uint64_t size =
+        align8(align8(sizeof(r) + r.keyLength) + uint64_t(r.dataSize));
+    if (slot.offset + size > packSize) {
+      continue;
+    }
+    byHash.emplace(slot.keyHash, live.size());
+    live.push_back({slot.keyHash, slot.offset, size, r.storedAt});
+    liveBytes += size;
+  }
+
+  // 2. 合并命中时间（lyrics.hits 中各进程追加的记录）
+  std::vector<HitRecord> hits;
+  int hitsFd = open(hitsPath_.c_str(), O_RDONLY | O_CLOEXEC);
+  if (hitsFd >= 0) {
+    struct stat st;
+    if (fstat(hitsFd, &st) == 0) {
+      hits.resize(st.st_size / sizeof(HitRecord));
+      if (!readAll(hitsFd, hits.data(), hits.size() * sizeof(HitRecord), 0)) {
+        hits.clear();
+      }
+    }
+    close(hitsFd);
+  }
+  for (const auto &hit : hits) {
+    auto it = byHash.find(hit.keyHash);
+    if (it != byHash.end()) {
+      live[it->second].lastUse = std::max(live[it->second].lastUse, hit.accessedAt);
+    }
+  }
+
+  // 3. 判断是否需要压缩：超出预算，或被覆盖的旧记录超过文件的 1/4
+  const uint64_t dead = packSize - std::min(packSize, liveBytes + sizeof(PackHeader));
+  const bool overBudget = maxBytes > 0 && liveBytes + sizeof(PackHeader) > maxBytes;
+  if (!overBudget && (dead < 64 * 1024 || dead * 4 < packSize)) {
+    close(packFd);
+    // 命中记录只保留仍有效的 key，避免 lyrics.hits 无限增长
+    if (hits.size() > live.size() * 2 + 1024) {
+      std::vector<HitRecord> merged;
+      merged.reserve(live.size());
+      for (const auto &rec : live) {
+        merged.push_back({rec.keyHash, rec.lastUse});
+      }
+      replaceFile(hitsPath_, merged.data(), merged.size() * sizeof(HitRecord));
+    }
+    return false;
+  }
+  size_t evicted = 0;
+  if (overBudget) {
+    // 最近使用的在前，保留到预算的 90%，避免每次写入后都要再次压缩
+    std::sort(live.begin(), live.end(), [](const LiveRecord &a, const LiveRecord &b) {
+      return a.lastUse > b.lastUse;
+    });
+    const uint64_t target = maxBytes / 10 * 9;
+    uint64_t kept = sizeof(PackHeader);
+    size_t n = 0;
+    while (n < live.size() && kept + live[n].size <= target) {
+      kept += live[n++].size;
+    }
+    evicted = live.size() - n;
+    live.resize(n);
+  }
+  // 按原偏移顺序复制，顺序读取旧文件
+  std::sort(live.begin(), live.end(), [](const LiveRecord &a, const LiveRecord &b) {
+    return a.offset < b.offset;
+  });
+
+  // 4. 写入新的 pack 和索引（临时文件，代数加一），再依次 rename 替换
+  const uint64_t generation = ph.generation + 1;
+  const auto packTmp = uniqueTmpPath(packPath_);
+  int outFd = open(packTmp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (outFd < 0) {
+    close(packFd);
+    ERROR("  >> Failed to create %s", packTmp.c_str());
+    return false;
+  }
+  size_t capacity = kInitialCapacity;
+  while (live.size() * 2 > capacity) {
+    capacity *= 2;
+  }
+  std::vector<IndexSlot> newSlots(capacity);
+  std::vector<HitRecord> newHits;
+  newHits.reserve(live.size());
+  const PackHeader outHeader{kPackMagic, kPackVersion, 0, generation};
+  bool ok = writeAll(outFd, &outHeader, sizeof(outHeader), 0);
+  uint64_t out = sizeof(outHeader);
+  std::vector<std::byte> buffer;
+  for (const auto &rec : live) {
+    if (!ok || stop.stop_requested()) {
+      ok = false;
+      break;
+    }
+    buffer.resize(rec.size);
+    ok = readAll(packFd, buffer.data(), rec.size, rec.offset) &&
+         writeAll(outFd, buffer.data(), rec.size, out);
+    placeSlot(newSlots, {rec.keyHash, out});
+    newHits.push_back({rec.keyHash, rec.lastUse});
+    out += rec.size;
+  }
+  ok = ok && fdatasync(outFd) == 0;
+  close(outFd);
+  close(packFd);
+  const auto idxTmp = uniqueTmpPath(indexPath_);
+  if (ok) {
+    int fd = open(idxTmp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    ok = fd >= 0 && writeIndex(fd, newSlots, live.size(), generation) &&
+         fdatasync(fd) == 0;
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+  // 先替换 pack 再替换索引：读者在索引 inode 变化时重新映射两个文件，
+  // 两次 rename 之间新 pack 与旧索引的代数不同，读者不会按旧偏移读取新 pack，只会未命中
+  ok = ok && rename(packTmp.c_str(), packPath_.c_str()) == 0 &&
+       rename(idxTmp.c_str(), indexPath_.c_str()) == 0;
+  if (!ok) {
+    unlink(packTmp.c_str());
+    unlink(idxTmp.c_str());
+    if (!stop.stop_requested()) {
+      ERROR("  >> Failed to compact lyrics pack: %s", packPath_.c_str());
+    }
+    return false;
+  }
+  replaceFile(hitsPath_, newHits.data(), newHits.size() * sizeof(HitRecord));
+
+  result.packBytes = out;
+  result.indexBytes = sizeof(IndexHeader) + capacity * sizeof(IndexSlot);
+  result.entries = live.size();
+  result.lastEvicted = evicted;
+  result.lastReclaimed = packSize - out;
+  return true;
+}
+
+LyricsPack::Stats LyricsPack::stats() {
+  Stats s;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    s = lastCompaction_;
+  }
+  std::error_code ec;
+  s.packBytes = std::filesystem::file_size(packPath_, ec);
+  if (ec) {
+    s.packBytes = 0;
+  }
+  s.indexBytes = std::filesystem::file_size(indexPath_, ec);
+  if (ec) {
+    s.indexBytes = 0;
+  }
+  s.entries = size();
+  return s;
+}
+
+void LyricsPack::logStats() {
+  const Stats s = stats();
+  INFO("  >> Lyrics pack: entries=%zu pack=%" PRIu64 " index=%" PRIu64
+       " bytes, compactions=%" PRIu64 " (last: %.1f ms, %zu evicted, %" PRIu64
+       " bytes reclaimed)",
+       s.entries, s.packBytes, s.indexBytes, s.compactions, s.lastCompactionMs,
+       s.lastEvicted, s.lastReclaimed);
+}
+
+size_t LyricsPack::migrate(const std::filesystem::path &dir,
+                           std::stop_token stop) {
+  size_t imported = 0;
+  std::error_code ec;
+  for (const auto &entry : std::filesystem::directory_iterator(dir, ec)) {
+    if (stop.stop_requested()) {
+      break;
+    }
+    const auto &path = entry.path();
+    if (!entry.is_regular_file(ec) || path.extension() != ".txt") {
+      continue;
+    }
+    // 旧版缓存的文件名就是查询 key
+    const std::string key = path.stem().string();
+    std::shared_ptr<const LyricsDocument> lyrics = find(key);
+    if (!lyrics) {
+      std::ifstream file(path, std::ios::binary);
+      std::string text(std::istreambuf_iterator<char>(file), {});
+      lyrics = LyricsDocument::parse(text);
+      if (!lyrics || !insert(key, *lyrics, LyricsSource::Import, text)) {
+        continue; // 无法解析或写入失败的文件保留原样
+      }
+    }
+    std::filesystem::remove(path, ec);
+    ++imported;
+  }
+  if (imported > 0) {
+    INFO("  >> Migrated %zu cached lyrics files into %s", imported,
+         packPath_.c_str());
+  }
+  return imported;
+}
@@ -0,0 +1,274 @@
+#include "../include/lyrics_provider.h"
+#include "common.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdlib>
+
+// 对冲等待时间的范围：太短时几乎每次都同时请求所有来源，太长时对冲没有意义
+static constexpr auto kMinHedgeDelay = std::chrono::milliseconds(50);
+static constexpr auto kMaxHedgeDelay = std::chrono::seconds(3);
+
+static double toMillis(std::chrono::microseconds us) { return us.count() / 1000.0; }
+
+LocalProvider::LocalProvider(std::string name, Lookup lookup)
+    : LyricsProvider({std::move(name), kProviderLocal | kProviderSynced, 0,
+                      std::chrono::milliseconds(0)}),
+      lookup_(std::move(lookup)) {}
+
+void LocalProvider::lookup(const LyricsQuery &query, const FetchWorker::CancelFlag &,
+                           Callback done) {
+  done(lookup_(query), LyricsMiss::NotFound);
+}
+
+bool checkLyricsResponse(const FetchWorker::Response &response, LyricsMiss &miss) {
+  miss = LyricsMiss::NetworkError;
+  if (response.result == CURLE_ABORTED_BY_CALLBACK) {
+    return false; // 已被取消（其他来源先返回了结果）
+  }
+  if (response.result != CURLE_OK) {
+    ERROR("  >> CURL error: %s", curl_easy_strerror(response.result));
+    return false;
+  }
+  if (response.status != 200) {
+    if (response.status == 404) {
+      miss = LyricsMiss::NotFound; // 没有匹配的记录
+      return false;
+    }
+    ERROR("  >> HTTP error: %ld", response.status);
+    return false;
+  }
+  if (response.body.empty()) {
+    ERROR("  >> No content received");
+    return false;
+  }
+  return true;
+}
+
+bool rankCandidate(const LyricsQuery &query, std::string_view title,
+                   std::string_view artist, int64_t durationMs, int64_t toleranceMs,
+                   MatchRank &rank) {
+  int64_t delta = 0;
+  if (query.lengthMs > 0 && durationMs > 0) {
+    delta = std::llabs(durationMs - query.lengthMs);
+    if (delta > toleranceMs) {
+      return false;
+    }
+  }
+  rank = {normalizeTitle(title) != query.track.title,
+          !query.track.artist.empty() && normalizeArtists(artist) != query.track.artist,
+          delta};
+  return true;
+}
+
+void LatencyTracker::record(std::chrono::microseconds latency) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (samples_.size() < kWindow) {
+    samples_.push_back(latency.count());
+  } else {
+    samples_[next_] = latency.count();
+  }
+  next_ = (next_ + 1) % kWindow;
+  ++total_;
+}
+
+std::chrono::microseconds
+LatencyTracker::percentile(int percent, std::chrono::microseconds fallback) const {
+  std::vector<int64_t> sorted;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (samples_.size() < kMinSamples) {
+      return fallback;
+    }
+    sorted = samples_;
+  }
+  const size_t rank = (sorted.size() * size_t(percent) + 99) / 100; // 最近秩
+  auto nth = sorted.begin() + std::clamp<size_t>(rank, 1, sorted.size()) - 1;
+  std::nth_element(sorted.begin(), nth, sorted.end());
+  return std::chrono::microseconds(*nth);
+}
+
+size_t LatencyTracker::count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return total_;
+}
+
+struct LyricsResolver::Race {
+  LyricsQuery query;
+  LyricsProvider::Callback done;
+  FetchWorker::CancelFlag cancel = std::make_shared<std::atomic<bool>>(false);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::mutex mutex; // 保护以下成员
+  size_t next = 0;    // 下一个要启动的远程来源
+  size_t pending = 0; // 已启动、还没有返回的来源数
+  bool finished = false;
+  LyricsMiss miss = LyricsMiss::NotFound;
+};
+
+LyricsResolver::LyricsResolver(FetchWorker &worker,
+                               std::vector<std::unique_ptr<LyricsProvider>> providers)
+    : worker_(worker) {
+  for (auto &provider : providers) {
+    auto entry = std::make_unique<Entry>();
+    const bool local = provider->isLocal();
+    entry->provider = std::move(provider);
+    (local ? local_ : remote_).push_back(std::move(entry));
+  }
+}
+
+std::shared_ptr<const LyricsDocument>
+LyricsResolver::resolveLocal(const LyricsQuery &query) {
+  for (auto &entry : local_) {
+    const auto start = std::chrono::steady_clock::now();
+    std::shared_ptr<const LyricsDocument> result;
+    entry->provider->lookup(query, nullptr,
+                            [&result](std::shared_ptr<const LyricsDocument> lyrics,
+                                      LyricsMiss) { result = std::move(lyrics); });
+    entry->latency.record(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start));
+    if (result) {
+      ++entry->hits;
+      return result;
+    }
+    ++entry->misses;
+  }
+  return nullptr;
+}
+
+void LyricsResolver::resolveRemote(const LyricsQuery &query,
+                                   LyricsProvider::Callback done) {
+  if (remote_.empty()) {
+    done(nullptr, LyricsMiss::NotFound);
+    return;
+  }
+  auto race = std::make_shared<Race>();
+  race->query = query;
+  race->done = std::move(done);
+  std::unique_lock<std::mutex> lock(race->mutex);
+  launchNext(race, lock);
+}
+
+void LyricsResolver::launchNext(const std::shared_ptr<Race> &race,
+                                std::unique_lock<std::mutex> &lock) {
+  const size_t index = race->next++;
+  ++race->pending;
+  lock.unlock();
+  Entry &entry = *remote_[index];
+  const ProviderInfo &info = entry.provider->info();
+  if (index > 0) {
+    DEBUG("  >> Querying lyrics provider %s after %.1f ms", info.name.c_str(),
+          std::chrono::duration<double, std::milli>(
+              std::chrono::steady_clock::now() - race->start).count());
+  }
+  if (index + 1 < remote_.size()) {
+    // 在这个来源通常的耗时（p95）内没有返回时，同时查询下一个来源
+    const auto delay = std::clamp(
+        std::chrono::ceil<std::chrono::milliseconds>(entry.latency.percentile(
+            95, std::chrono::duration_cast<std::chrono::microseconds>(info.expectedLatency))),
+        std::chrono::milliseconds(kMinHedgeDelay), std::chrono::milliseconds(kMaxHedgeDelay));
+    worker_.schedule(delay, [this, race, index] {
+      std::unique_lock<std::mutex> lock(race->mutex);
+      if (race->finished || race->next != index + 1) {
+        return; // 已有结果，或下一个来源已经启动
+      }
+      launchNext(race, lock);
+    });
+  }
+  const auto start = std::chrono::steady_clock::now();
+  entry.provider->lookup(race->query, race->cancel,
+                         [this, race, index, start](std::shared_ptr<const LyricsDocument> lyrics,
+                                                    LyricsMiss miss) {
+    onResult(race, index, start, std::move(lyrics), miss);
+  });
+}
+
+void LyricsResolver::onResult(const std::shared_ptr<Race> &race, size_t index,
+                              std::chrono::steady_clock::time_point start,
+                              std::shared_ptr<const LyricsDocument> lyrics,
+                              LyricsMiss miss) {
+  Entry &entry = *remote_[index];
+  const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start);
+  // 被取消的请求没有完整的耗时，不计入
+  if (lyrics || !race->cancel->load()) {
+    entry.latency.record(elapsed);
+  }
+  if (lyrics && lyrics->empty()) {
+    lyrics.reset();
+    miss = LyricsMiss::NoSynced;
+  }
+  std::unique_lock<std::mutex> lock(race->mutex);
+  if (race->finished) {
+    return;
+  }
+  --race->pending;
+  if (lyrics) {
+    ++entry.hits;
+    race->finished = true;
+    lock.unlock();
+    worker_.cancel(race->cancel); // 中止其他来源的请求
+    DEBUG("  >> Lyrics resolved by %s in %.1f ms (total %.1f ms)",
+          entry.provider->info().name.c_str(), toMillis(elapsed),
+          std::chrono::duration<double, std::milli>(
+              std::chrono::steady_clock::now() - race->start).count());
+    race->done(std::move(lyrics), miss);
+    return;
+  }
+  ++entry.misses;
+  race->miss = std::max(race->miss, miss);
+  if (race->next < remote_.size()) {
+    launchNext(race, lock); // 没有结果，不必等到对冲时间
+    return;
+  }
+  if (race->pending > 0) {
+    return; // 等待已启动的来源
+  }
+  race->finished = true;
+  miss = race->miss;
+  lock.unlock();
+  race->done(nullptr, miss);
+}
+
+bool LyricsResolver::enabled(std::string_view name) const {
+  for (const auto *list : {&local_, &remote_}) {
+    for (const auto &entry : *list) {
+      if (entry->provider->info().name == name) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+std::string LyricsResolver::names() const {
+  std::string result;
+  for (const auto *list : {&local_, &remote_}) {
+    for (const auto &entry : *list) {
+      if (!result.empty()) {
+        result += ',';
+      }
+      result += entry->provider->info().name;
+    }
+  }
+  return result;
+}
+
+void LyricsResolver::logStats() const {
+  for (const auto *list : {&local_, &remote_}) {
+    for (const auto &entry : *list) {
+      const ProviderInfo &info = entry->provider->info();
+      const size_t samples = entry->latency.count();
+      if (samples < LatencyTracker::kMinSamples) {
+        INFO("  >> Provider %s: %" PRIu64 " hits, %" PRIu64 " misses, %zu samples, "
+             "expected latency %ld ms, cost %d",
+             info.name.c_str(), entry->hits.load(), entry->misses.load(), samples,
+             long(info.expectedLatency.count()), info.cost);
+        continue;
+      }
+      INFO("  >> Provider %s: %" PRIu64 " hits, %" PRIu64 " misses, %zu samples, "
+           "p50 %.2f ms, p95 %.2f ms, cost %d",
+           info.name.c_str(), entry->hits.load(), entry->misses.load(), samples,
+           toMillis(entry->latency.percentile(50, {})),
+           toMillis(entry->latency.percentile(95, {})), info.cost);
+    }
+  }
+}
@@ -0,0 +1,245 @@
+#include "../include/negative_cache.h"
+#include "../include/utils.hpp"
+#include "common.h"
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// 文件格式（本机字节序）：[MissHeader][MissRecord]...，后写入的记录覆盖先写入的，
+// expiresAt 为 0 的记录表示删除
+static constexpr uint32_t kMissMagic = 0x4d4e4c57; // "WLNM"
+static constexpr uint16_t kMissVersion = 1;
+
+struct MissHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t reserved;
+  uint64_t reserved2;
+};
+
+struct MissRecord {
+  uint64_t keyHash;
+  uint32_t expiresAt; // Unix 秒
+  uint8_t reason;
+  uint8_t reserved[3];
+};
+static_assert(sizeof(MissRecord) == 16);
+
+static int openLog(const std::filesystem::path &path, int flags) {
+  return open(path.c_str(), flags | O_WRONLY | O_APPEND | O_CLOEXEC, 0644);
+}
+
+// 作用域内持有文件排他锁（fd 无效或加锁失败时不加锁）
+struct FileLock {
+  explicit FileLock(int fd) : fd(fd >= 0 && flock(fd, LOCK_EX) == 0 ? fd : -1) {}
+  ~FileLock() {
+    if (fd >= 0) {
+      flock(fd, LOCK_UN);
+    }
+  }
+  FileLock(const FileLock &) = delete;
+  FileLock &operator=(const FileLock &) = delete;
+  int fd;
+};
+
+NegativeCache::NegativeCache(const std::filesystem::path &dir)
+    : path_(dir / "lyrics.miss"), lockPath_(dir / "lyrics.miss.lock") {
+  std::error_code ec;
+  std::filesystem::create_directories(dir, ec);
+  lockFd_ = open(lockPath_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (lockFd_ < 0) {
+    WARN("  >> Failed to open negative cache lock: %s", lockPath_.c_str());
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  FileLock fileLock(lockFd_);
+  load();
+}
+
+NegativeCache::~NegativeCache() {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+  if (lockFd_ >= 0) {
+    close(lockFd_);
+  }
+}
+
+std::time_t NegativeCache::ttlOf(LyricsMiss reason) {
+  switch (reason) {
+  case LyricsMiss::NotFound:
+    return 7 * 24 * 3600;
+  case LyricsMiss::NoSynced:
+    return 3 * 24 * 3600;
+  case LyricsMiss::NetworkError:
+    return 5 * 60;
+  }
+  return 0;
+}
+
+ssize_t NegativeCache::readLog() {
+  int fd = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return -1;
+  }
+  struct stat st{};
+  ssize_t count = -1;
+  if (fstat(fd, &st) == 0) {
+    const bool replaced = st.st_dev != fileDev_ || st.st_ino != fileIno_ ||
+                          st.st_size < readSize_;
+    off_t from = replaced ? 0 : readSize_;
+    if (from == 0) {
+      MissHeader header{};
+      if (st.st_size >= (off_t)sizeof(header) &&
+          pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+          header.magic == kMissMagic && header.version == kMissVersion) {
+        from = sizeof(header);
+      } else if (st.st_size > 0) {
+        WARN("  >> Negative cache %s is invalid, recreating", path_.c_str());
+      }
+    }
+    // 只读取完整的记录，正在追加的记录下次再读
+    std::vector<MissRecord> records(from != 0 ? (st.st_size - from) / sizeof(MissRecord) : 0);
+    const size_t bytes = records.size() * sizeof(MissRecord);
+    if (from != 0 && pread(fd, records.data(), bytes, from) == (ssize_t)bytes) {
+      if (replaced) {
+        entries_.clear(); // 重写后的文件包含所有有效记录
+      }
+      const int64_t now = std::time(nullptr);
+      for (const auto &r : records) {
+        if (r.expiresAt > now) {
+          entries_[r.keyHash] = {r.expiresAt, static_cast<LyricsMiss>(r.reason)};
+        } else {
+          entries_.erase(r.keyHash);
+        }
+      }
+      fileDev_ = st.st_dev;
+      fileIno_ = st.st_ino;
+      readSize_ = from + bytes;
+      count = records.size();
+    }
+  }
+  close(fd);
+  return count;
+}
+
+void NegativeCache::refresh() {
+  struct stat st{};
+  if (stat(path_.c_str(), &st) != 0 ||
+      (st.st_dev == fileDev_ && st.st_ino == fileIno_ && st.st_size == readSize_)) {
+    return;
+  }
+  readLog();
+}
+
+void NegativeCache::load() {
+  const ssize_t count = readLog();
+  // 过期/被覆盖的记录较多或文件无效时重写
+  if (count <= 0 || size_t(count) > entries_.size() * 2 + 256) {
+    compact();
+  } else {
+    fd_ = openLog(path_, 0);
+  }
+  DEBUG("  >> Negative cache loaded: %zu entries (%zd records)", entries_.size(), count);
+}
+
+void NegativeCache::compact() {
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+  const std::filesystem::path tmp = uniqueTmpPath(path_);
+  int fd = openLog(tmp, O_CREAT | O_TRUNC);
+  if (fd < 0) {
+    WARN("  >> Failed to create negative cache: %s", tmp.c_str());
+    return;
+  }
+  std::vector<MissRecord> records;
+  records.reserve(entries_.size());
+  for (const auto &[keyHash, entry] : entries_) {
+    records.push_back({keyHash, static_cast<uint32_t>(entry.expiresAt),
+                       static_cast<uint8_t>(entry.reason), {}});
+  }
+  const MissHeader header{kMissMagic, kMissVersion, 0, 0};
+  if (!writeAll(fd, &header, sizeof(header)) ||
+      !writeAll(fd, records.data(), records.size() * sizeof(MissRecord)) ||
+      rename(tmp.c_str(), path_.c_str()) != 0) {
+    WARN("  >> Failed to write negative cache: %s", path_.c_str());
+    close(fd);
+    unlink(tmp.c_str());
+    return;
+  }
+  struct stat st{};
+  if (fstat(fd, &st) == 0) {
+    fileDev_ = st.st_dev;
+    fileIno_ = st.st_ino;
+    readSize_ = st.st_size;
+  }
+  fd_ = fd; // O_APPEND，重命名后继续追加
+}
+
+void NegativeCache::append(uint64_t keyHash, const Entry &entry) {
+  FileLock fileLock(lockFd_);
+  refresh(); // 重建文件时不丢失其他进程追加的记录
+  struct stat current{}, opened{};
+  if (stat(path_.c_str(), &current) != 0) {
+    compact(); // 文件被删除：用内存中的记录重建
+  } else if (fd_ < 0 || fstat(fd_, &opened) != 0 || opened.st_ino != current.st_ino ||
+             opened.st_dev != current.st_dev) {
+    // 其他进程重写了文件（重命名替换），继续追加到新文件
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+    fd_ = openLog(path_, 0);
+  }
+  if (fd_ < 0) {
+    return; // 文件不可写时只保留在内存中
+  }
+  const MissRecord record{keyHash, static_cast<uint32_t>(entry.expiresAt),
+                          static_cast<uint8_t>(entry.reason), {}};
+  if (!writeAll(fd_, &record, sizeof(record))) {
+    WARN("  >> Failed to append negative cache: %s", path_.c_str());
+  } else if (fstat(fd_, &opened) == 0 && opened.st_dev == fileDev_ &&
+             opened.st_ino == fileIno_ && readSize_ + (off_t)sizeof(record) == opened.st_size) {
+    readSize_ = opened.st_size; // 自己追加的记录不必再读
+  }
+}
+
+bool NegativeCache::contains(std::string_view key, LyricsMiss *reason) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  refresh();
+  auto it = entries_.find(hash64(key));
+  if (it == entries_.end()) {
+    return false;
+  }
+  if (it->second.expiresAt <= std::time(nullptr)) {
+    entries_.erase(it); // 过期记录在下次重写文件时清理
+    return false;
+  }
+  if (reason) {
+    *reason = it->second.reason;
+  }
+  return true;
+}
+
+void NegativeCache::record(std::string_view key, LyricsMiss reason) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const Entry entry{std::time(nullptr) + ttlOf(reason), reason};
+  const uint64_t keyHash = hash64(key);
+  entries_[keyHash] = entry;
+  append(keyHash, entry);
+}
+
+void NegativeCache::erase(std::string_view key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const uint64_t keyHash = hash64(key);
+  // 即使内存中没有也写入删除记录：可能是其他进程在本进程加载后记录的
+  entries_.erase(keyHash);
+  append(keyHash, {0, LyricsMiss::NotFound});
+}
+
+size_t NegativeCache::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
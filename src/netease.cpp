@@ -0,0 +1,155 @@
+#include "../include/netease.h"
+#include "../include/utils.hpp"
+#include "common.h"
+#include <nlohmann/json.hpp>
+
+// 网易云音乐接口返回的 code（HTTP 状态码总是 200）
+static bool codeOk(const nlohmann::json &json) {
+  auto code = json.find("code");
+  return code == json.end() || (code->is_number() && code->get<int>() == 200);
+}
+
+// 对象中 field 对象的 lyric 字符串（"lrc"、"tlyric"），没有时为空
+static std::string lyricOf(const nlohmann::json &json, const char *field) {
+  auto it = json.find(field);
+  if (it == json.end() || !it->is_object()) {
+    return {};
+  }
+  auto lyric = it->find("lyric");
+  return lyric != it->end() && lyric->is_string() ? lyric->get<std::string>()
+                                                   : std::string();
+}
+
+std::string neteaseSearchUrl(std::string_view baseUrl, const LyricsQuery &query) {
+  // 搜索使用原始写法（只去除末尾的版本限定），规范化的歌名/歌手只用于本地排序
+  const std::string &title = query.title.empty() ? query.track.title : query.title;
+  const std::string &artist = query.artist.empty() ? query.track.artist : query.artist;
+  std::string keywords(stripTitleQualifiers(title));
+  if (!artist.empty()) {
+    keywords += ' ' + artist;
+  }
+  std::string url(baseUrl);
+  url += "/api/search/get?type=1&limit=10&s=" + url_encode(keywords);
+  return url;
+}
+
+std::string neteaseLyricUrl(std::string_view baseUrl, int64_t songId) {
+  std::string url(baseUrl);
+  url += "/api/song/lyric?lv=1&tv=-1&id=" + std::to_string(songId);
+  return url;
+}
+
+int64_t parseNeteaseSearch(std::string_view body, const LyricsQuery &query,
+                           int64_t toleranceMs, LyricsMiss &miss) {
+  miss = LyricsMiss::NetworkError;
+  auto json = nlohmann::json::parse(body, nullptr, false);
+  if (json.is_discarded() || !json.is_object() || !codeOk(json)) {
+    WARN("  >> Invalid netease response");
+    return 0;
+  }
+  miss = LyricsMiss::NotFound;
+  auto result = json.find("result");
+  if (result == json.end() || !result->is_object()) {
+    return 0;
+  }
+  auto songs = result->find("songs");
+  if (songs == result->end() || !songs->is_array()) {
+    return 0;
+  }
+  // 按 rankCandidate 排序，相同时保留先出现的结果（搜索的相关度顺序）
+  int64_t best = 0;
+  MatchRank bestRank{};
+  for (const auto &song : *songs) {
+    if (!song.is_object() || !song.contains("id") || !song["id"].is_number() ||
+        !song.contains("name") || !song["name"].is_string()) {
+      continue;
+    }
+    std::string artists;
+    auto list = song.find("artists");
+    if (list == song.end()) {
+      list = song.find("ar"); // cloudsearch 接口的字段名
+    }
+    if (list != song.end() && list->is_array()) {
+      for (const auto &artist : *list) {
+        if (artist.is_object() && artist.contains("name") && artist["name"].is_string()) {
+          artists += (artists.empty() ? "" : ", ") + artist["name"].get<std::string>();
+        }
+      }
+    }
+    int64_t durationMs = 0;
+    for (const char *field : {"duration", "dt"}) {
+      if (song.contains(field) && song[field].is_number()) {
+        durationMs = song[field].get<int64_t>();
+        break;
+      }
+    }
+    MatchRank rank;
+    if (!rankCandidate(query, song["name"].get<std::string>(), artists, durationMs,
+                       toleranceMs, rank)) {
+      continue;
+    }
+    if (!best || rank < bestRank) {
+      best = song["id"].get<int64_t>();
+      bestRank = rank;
+    }
+  }
+  return best;
+}
+
+std::shared_ptr<const LyricsDocument> parseNeteaseLyric(std::string_view body,
+                                                        LyricsMiss &miss) {
+  miss = LyricsMiss::NetworkError;
+  auto json = nlohmann::json::parse(body, nullptr, false);
+  if (json.is_discarded() || !json.is_object() || !codeOk(json)) {
+    WARN("  >> Invalid netease response");
+    return nullptr;
+  }
+  miss = LyricsMiss::NotFound; // 纯音乐（nolyric）或未收录（uncollected）
+  const std::string lyric = lyricOf(json, "lrc");
+  if (lyric.empty()) {
+    return nullptr;
+  }
+  auto lyrics = LyricsDocument::parse(lyric, lyricOf(json, "tlyric"));
+  if (!lyrics) {
+    miss = LyricsMiss::NoSynced;
+  }
+  return lyrics;
+}
+
+NeteaseProvider::NeteaseProvider(FetchWorker &worker, std::string baseUrl)
+    : LyricsProvider({"netease", kProviderSynced | kProviderTranslation, 2,
+                      std::chrono::milliseconds(600)}),
+      worker_(worker), baseUrl_(std::move(baseUrl)) {
+  while (baseUrl_.ends_with('/')) {
+    baseUrl_.pop_back();
+  }
+}
+
+void NeteaseProvider::lookup(const LyricsQuery &query,
+                             const FetchWorker::CancelFlag &cancel, Callback done) {
+  if (query.track.title.empty()) {
+    done(nullptr, LyricsMiss::NotFound);
+    return;
+  }
+  worker_.submit(neteaseSearchUrl(baseUrl_, query),
+                 [this, query, cancel, done](FetchWorker::Response &&response) {
+    LyricsMiss miss = LyricsMiss::NetworkError;
+    int64_t songId = 0;
+    if (checkLyricsResponse(response, miss)) {
+      songId = parseNeteaseSearch(response.body, query, kLengthTolerance, miss);
+    }
+    if (!songId || (cancel && cancel->load())) {
+      done(nullptr, miss);
+      return;
+    }
+    worker_.submit(neteaseLyricUrl(baseUrl_, songId),
+                   [done](FetchWorker::Response &&response) {
+      LyricsMiss miss = LyricsMiss::NetworkError;
+      std::shared_ptr<const LyricsDocument> lyrics;
+      if (checkLyricsResponse(response, miss)) {
+        lyrics = parseNeteaseLyric(response.body, miss);
+      }
+      done(std::move(lyrics), miss);
+    }, cancel);
+  }, cancel);
+}
@@ -1,5 +1,6 @@
 #include "../include/player_manager.h"
 #include "common.h"
+#include "../include/utils.hpp"
 #include <cstddef>
 #include <iostream>
 #include <mutex>
@@ -25,16 +26,21 @@ PlayerManager::PlayerManager(
     return;
   }
   INFO("D-Bus connection initialized");
-  startMonitoring(); // 初始化时自动启动监听
+  // 初始化时自动启动监听：枚举播放器、读取状态（可能触发网络请求）在后台进行，
+  // 不阻塞 waybar 加载模块
+  startThread_ = std::thread([this]() { startMonitoring(); });
 }
 
 PlayerManager::~PlayerManager() {
   stopMonitoring(); // 析构时停止监听
 }
 
-// 切换到下一个播放器，如果没有播放器可用，则返回空字符串
+// 切换到下一个播放器，如果没有播放器可用，则返回空字符串（调用方持有 mutex_）
 std::string PlayerManager::switchNewPlayer() const {
-  auto allPlayer = getAllPlayers();
+  std::vector<std::string> allPlayer;
+  for (const auto &[name, _] : players_) {
+    allPlayer.push_back(name);
+  }
   if (allPlayer.empty()) {
     return "";
   }
@@ -53,18 +59,9 @@ std::string PlayerManager::switchNewPlayer() const {
 std::vector<std::string> PlayerManager::listPlayerNames() {
   std::vector<std::string> playerNames;
   try {
-    // 连接到会话总线
-    auto connection = sdbus::createSessionBusConnection();
-
-    // 创建 D-Bus 代理以访问 org.freedesktop.DBus 服务
-    sdbus::ServiceName org_freedesktop_DBus{"org.freedesktop.DBus"};
-    sdbus::ObjectPath org_freedesktop_DBus_path{"/org/freedesktop/DBus"};
-    auto dbusProxy = sdbus::createProxy(*connection, 
-      org_freedesktop_DBus,
-      org_freedesktop_DBus_path);
-
+    // 复用已有连接上的 org.freedesktop.DBus 代理，不再新建会话总线连接
     std::vector<std::string> allNames;
-    dbusProxy->callMethod("ListNames")
+    dbusProxy_->callMethod("ListNames")
         .onInterface("org.freedesktop.DBus")
         .storeResultsTo(allNames);
 
@@ -79,16 +76,51 @@ std::vector<std::string> PlayerManager::listPlayerNames() {
   return playerNames;
 }
 
-PlayerState PlayerManager::getPlayerState() const {
+// 播放器随歌词提供的翻译/音译歌词（LRC，非标准字段，可选）
+static constexpr const char *kTranslationKey = "xesam:asTextTranslation";
+
+std::shared_ptr<const LyricsDocument> PlayerManager::parseLyrics(
+    const std::map<std::string, sdbus::Variant> &metadata) const {
+  auto it = metadata.find("xesam:asText");
+  if (it == metadata.end()) {
+    return nullptr;
+  }
+  const std::string text = it->second.get<std::string>();
+  std::string translation;
+  it = metadata.find(kTranslationKey);
+  if (it != metadata.end() && it->second.containsValueOfType<std::string>()) {
+    translation = it->second.get<std::string>();
+  }
+  const LyricsFingerprint fingerprint{hash64(text), text.size(), hash64(translation)};
+  {
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+    if (fingerprint == lyricsFingerprint_) {
+      return lyricsCache_; // 歌词未变化（暂停/继续、跳转等），不再解析
+    }
+  }
+  auto lyrics = LyricsDocument::parse(text, translation);
+  std::lock_guard<std::mutex> lock(cacheMutex_);
+  lyricsFingerprint_ = fingerprint;
+  lyricsCache_ = lyrics;
+  return lyrics;
+}
 
-  PlayerState state = {PlaybackStatus::Stopped, {}, 0, currentPlayer_};
-  if(currentPlayer_.empty()) {
+PlayerState PlayerManager::getPlayerState(bool fetchMetadata) const {
+  const std::string player = getCurrentPlayerName();
+  PlayerState state = {PlaybackStatus::Stopped, {}, 0, player};
+  if(player.empty()) {
     return state;
   }
-  // 等待300毫秒以确保播放器已经准备好
-  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  if (!fetchMetadata) {
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+    fetchMetadata = metadataPlayer_ != player;
+  }
+  if (fetchMetadata) {
+    // 等待300毫秒以确保播放器已经准备好
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  }
 
-  sdbus::ServiceName destination{std::move(currentPlayer_)};
+  sdbus::ServiceName destination{player};
   sdbus::ObjectPath objectPath{"/org/mpris/MediaPlayer2"};
   auto playerProxy = sdbus::createProxy(*dbusConn_, std::move(destination),
                                         std::move(objectPath));
@@ -115,55 +147,30 @@ PlayerState PlayerManager::getPlayerState() const {
     state.status = PlaybackStatus::Unknown;
     return state;
   }
-  // 2. 获取媒体元数据
-  try {
-    sdbus::Variant metadata;
-    playerProxy->callMethod("Get")
-        .onInterface("org.freedesktop.DBus.Properties")
-        .withArguments("org.mpris.MediaPlayer2.Player", "Metadata")
-        .storeResultsTo(metadata);
-
-    auto md = metadata.get<std::map<std::string, sdbus::Variant>>();
-
-    // 解析标题
-    if (md.count("xesam:title")) {
-      state.metadata.title = md["xesam:title"].get<std::string>();
-    } else {
-      WARN("xesam:title not found in metadata");
-    }
-
-    // 歌词解析
-    if (md.count("xesam:asText")) {
-      state.metadata.lyrics = md["xesam:asText"].get<std::string>();
-    } else {
-      WARN("xesam:asText not found in metadata");
-    }
-
-    if (md.count("xesam:artist")) {
-      state.metadata.artist =
-          md["xesam:artist"].get<std::vector<std::string>>()[0];
-    } else {
-      // 如果没有找到 xesam:artist，尝试使用 xesam:albumArtist （array)
-      if (md.count("xesam:albumArtist")) {
-        state.metadata.artist =
-            md["xesam:albumArtist"].get<std::vector<std::string>>()[0];
-      } else {
-        WARN("xesam:albumArtist not found in metadata");
-      }
-    }
-    // 解析媒体长度
-    if (md.count("mpris:length")) {
-      // 数据类型是 int64_t
-      state.metadata.length = md["mpris:length"].get<int64_t>() / 1000;
-    } else {
-      WARN("mpris:length not found in metadata");
+  // 2. 获取媒体元数据（仅播放状态变化时复用缓存）
+  if (!fetchMetadata) {
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+    state.metadata = metadataCache_;
+  } else {
+    try {
+      sdbus::Variant metadata;
+      playerProxy->callMethod("Get")
+          .onInterface("org.freedesktop.DBus.Properties")
+          .withArguments("org.mpris.MediaPlayer2.Player", "Metadata")
+          .storeResultsTo(metadata);
+
+      parseMetadata(metadata.get<std::map<std::string, sdbus::Variant>>(),
+                    state.metadata);
+      std::lock_guard<std::mutex> lock(cacheMutex_);
+      metadataPlayer_ = player;
+      metadataCache_ = state.metadata;
+    } catch (const sdbus::Error &e) { // 捕获D-Bus特定错误
+      WARN("D-Bus error: %s", e.getMessage().c_str());
+      return state;
+    } catch (const std::exception &e) { // 捕获其他标准异常
+      WARN("General error: %s", e.what());
+      return state;
     }
-  } catch (const sdbus::Error &e) { // 捕获D-Bus特定错误
-    WARN("D-Bus error: %s", e.getMessage().c_str());
-    return state;
-  } catch (const std::exception &e) { // 捕获其他标准异常
-    WARN("General error: %s", e.what());
-    return state;
   }
 
   // 3. 获取播放位置
@@ -191,12 +198,16 @@ void PlayerManager::startMonitoring() {
     return;
 
   // 初始化当前活跃的播放器列表
-  for (const auto &name : listPlayerNames()) {
-    INFO("Found player: %s", name.c_str());
-    addNewPlayer(name); // 新播放器启动
+  const auto names = listPlayerNames();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto &name : names) {
+      INFO("Found player: %s", name.c_str());
+      addNewPlayer(name); // 新播放器启动
+    }
   }
   updatePlayerState();
-  DEBUG("Current player: [%s]", currentPlayer_.c_str());
+  DEBUG("Current player: [%s]", getCurrentPlayerName().c_str());
   INFO("Starting D-Bus signal monitoring");
   // 注册NameOwnerChanged信号监听器
   dbusProxy_->uponSignal("NameOwnerChanged")
@@ -205,18 +216,24 @@ void PlayerManager::startMonitoring() {
                    const std::string &newOwner) {
         if (name.find("org.mpris.MediaPlayer2.") != 0)
           return;
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (newOwner.empty()) {
-          // 播放器退出：从管理列表移除
-          players_.erase(name);
-          if (name == currentPlayer_) {
-            currentPlayer_ = switchNewPlayer();
-            updatePlayerState();
+        bool switched = false;
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          if (newOwner.empty()) {
+            // 播放器退出：从管理列表移除
+            players_.erase(name);
+            if (name == currentPlayer_) {
+              currentPlayer_ = switchNewPlayer();
+              switched = true;
+            }
+            INFO("Player exited: %s", name.c_str());
+          } else if (oldOwner.empty()) {
+            INFO("New player detected: %s", name.c_str());
+            addNewPlayer(name);
           }
-          INFO("Player exited: %s", name.c_str());
-        } else if (oldOwner.empty()) {
-          INFO("New player detected: %s", name.c_str());
-          addNewPlayer(name);
+        }
+        if (switched) {
+          updatePlayerState(); // 释放锁后读取状态（D-Bus 调用）
         }
       });
   // 启动事件循环
@@ -225,8 +242,17 @@ void PlayerManager::startMonitoring() {
 }
 
 void PlayerManager::stopMonitoring() {
-  // 遍历所有播放器代理，移除信号监听器
-  for (auto &[serviceName, playerProxy] : players_) {
+  // 等待后台启动完成，否则事件循环可能在 leaveEventLoop 之后才进入
+  if (startThread_.joinable()) {
+    startThread_.join();
+  }
+  // 遍历所有播放器代理，移除信号监听器（取出后在锁外进行，信号回调可能正在等待锁）
+  std::map<std::string, std::shared_ptr<sdbus::IProxy>> players;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    players.swap(players_);
+  }
+  for (auto &[serviceName, playerProxy] : players) {
     try{
       playerProxy->unregister();
       INFO("Unregistered player proxy for %s", serviceName.c_str());
@@ -236,40 +262,63 @@ void PlayerManager::stopMonitoring() {
       WARN("Failed to unregister player proxy for %s: Unknown error", serviceName.c_str());
     }
   }
-  players_.clear();
+  players.clear();
   dbusConn_->leaveEventLoop();
 }
-// Metadata 解析函数（实现）
+// Metadata 解析函数（Get Metadata 与 PropertiesChanged 信号共用）
 void PlayerManager::parseMetadata(
-    const std::map<std::string, sdbus::Variant> &metadata,
+    const std::map<std::string, sdbus::Variant> &md,
     PlayerMetadata &out) const {
   // 解析标题
-  if (metadata.count("xesam:title")) {
-    out.title = metadata.at("xesam:title").get<std::string>();
+  if (auto it = md.find("xesam:title"); it != md.end()) {
+    out.title = it->second.get<std::string>();
   } else {
-    out.title = "[Unknown Title]"; // 默认值避免空字符串
-    DEBUG("Metadata missing xesam:title");
+    WARN("xesam:title not found in metadata");
   }
 
-  // 解析艺术家（优先 xesam:artist，降级使用 albumArtist）
-  if (metadata.count("xesam:artist")) {
-    const auto &artists =
-        metadata.at("xesam:artist").get<std::vector<std::string>>();
-    out.artist = artists.empty() ? "[Unknown Artist]" : artists[0];
-  } else if (metadata.count("xesam:albumArtist")) {
-    const auto &albumArtists =
-        metadata.at("xesam:albumArtist").get<std::vector<std::string>>();
-    out.artist = albumArtists.empty() ? "[Unknown Artist]" : albumArtists[0];
-  } else {
-    out.artist = "[Unknown Artist]"; // 默认值
-    DEBUG("Metadata missing xesam:artist/albumArtist");
+  // 歌词解析（内容未变化时复用已解析的文档）
+  out.lyrics = parseLyrics(md);
+  if (!out.lyrics && !md.count("xesam:asText")) {
+    WARN("xesam:asText not found in metadata");
   }
 
-  // 解析歌词（musicfox 专有字段）
-  if (metadata.count("xesam:asText")) {
-    out.lyrics = metadata.at("xesam:asText").get<std::string>();
+  // 艺术家（优先 xesam:artist，没有时使用 xesam:albumArtist）
+  for (const char *key : {"xesam:artist", "xesam:albumArtist"}) {
+    auto it = md.find(key);
+    if (it == md.end()) {
+      continue;
+    }
+    const auto artists = it->second.get<std::vector<std::string>>();
+    if (!artists.empty()) {
+      out.artist = artists[0];
+    }
+    break;
+  }
+  if (out.artist.empty()) {
+    WARN("xesam:artist/albumArtist not found in metadata");
+  }
+  // 专辑名（可选，lrclib 精确匹配时使用）
+  if (auto it = md.find("xesam:album");
+      it != md.end() && it->second.containsValueOfType<std::string>()) {
+    out.album = it->second.get<std::string>();
+  }
+  // 解析媒体长度（数据类型是 int64_t，微秒）
+  if (auto it = md.find("mpris:length"); it != md.end()) {
+    out.length = it->second.get<int64_t>() / 1000;
   } else {
-    out.lyrics = ""; // 无歌词时置空
+    WARN("mpris:length not found in metadata");
+  }
+  // MusicBrainz 曲目 ID（可选，作为缓存 key 最可靠）
+  if (auto it = md.find("xesam:musicBrainzTrackID"); it != md.end()) {
+    const auto &mbid = it->second;
+    if (mbid.containsValueOfType<std::string>()) {
+      out.musicBrainzId = mbid.get<std::string>();
+    } else if (mbid.containsValueOfType<std::vector<std::string>>()) {
+      auto ids = mbid.get<std::vector<std::string>>();
+      if (!ids.empty()) {
+        out.musicBrainzId = ids[0];
+      }
+    }
   }
 }
 void PlayerManager::addNewPlayer(const std::string &serviceName) {
@@ -291,7 +340,8 @@ void PlayerManager::addNewPlayer(const std::string &serviceName) {
                             std::map<std::string, sdbus::Variant> &changedProps,
                             std::vector<std::string> &invalidatedProps) {
           DEBUG("PropertiesChanged: %s , interfaceName: [%s] , currentPlayer: %s",
-                serviceName.c_str(), interfaceName.c_str(), currentPlayer_.c_str());
+                serviceName.c_str(), interfaceName.c_str(),
+                getCurrentPlayerName().c_str());
           if (interfaceName != "org.mpris.MediaPlayer2.Player") {
             WARN("Ignoring non-player interface: %s", interfaceName.c_str());
             return;
@@ -302,8 +352,14 @@ void PlayerManager::addNewPlayer(const std::string &serviceName) {
             auto metadata = changedProps["Metadata"].get<std::map<std::string, sdbus::Variant>>();
             PlayerMetadata md;
             parseMetadata(metadata, md);
-            DEBUG("Metadata changed: title=[%s], artist=[%s], lyrics=[%s]",
-                  md.title.c_str(), md.artist.c_str(), md.lyrics.c_str());
+            DEBUG("Metadata changed: title=[%s], artist=[%s], lyrics=[%zu lines]",
+                  md.title.c_str(), md.artist.c_str(),
+                  md.lyrics ? md.lyrics->size() : 0);
+            // 信号中已是完整的 Metadata，直接作为该播放器的缓存，
+            // 状态更新时不再重新 Get（也不再复制一遍完整歌词）
+            std::lock_guard<std::mutex> lock(cacheMutex_);
+            metadataPlayer_ = serviceName;
+            metadataCache_ = std::move(md);
           }
           if(changedProps.count("PlaybackStatus")) {
             auto status = changedProps["PlaybackStatus"].get<std::string>();
@@ -312,7 +368,7 @@ void PlayerManager::addNewPlayer(const std::string &serviceName) {
           }
           // 触发上层回调（线程安全：D-Bus事件循环可能在独立线程，需确保回调线程安全）
           if (stateCallback_ && needCallback) {
-            updatePlayerState();
+            updatePlayerState(false);
           }
         });
 
@@ -326,11 +382,13 @@ void PlayerManager::addNewPlayer(const std::string &serviceName) {
 
 std::string PlayerManager::getCurrentPlayerName() const {
   // 优先返回musicfox播放器
+  std::lock_guard<std::mutex> lock(mutex_);
   return currentPlayer_;
 }
 
 std::vector<std::string> PlayerManager::getAllPlayers() const {
   std::vector<std::string> playerNames;
+  std::lock_guard<std::mutex> lock(mutex_);
   for (const auto &[name, _] : players_) {
     playerNames.push_back(name);
   }
@@ -339,14 +397,34 @@ std::vector<std::string> PlayerManager::getAllPlayers() const {
 
 // 实现切换当前播放器的方法（切换显示信息)
 void PlayerManager::setCurrentPlayer(const std::string &playerName) {
-  currentPlayer_ = playerName;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    currentPlayer_ = playerName;
+  }
   updatePlayerState();
 }
 
-// 更新播放器状态信息（调用回调）
-void PlayerManager::updatePlayerState() {
-  DEBUG("updatePlayerState: %s", currentPlayer_.c_str());
-  auto state = getPlayerState();
+// 当前播放器的代理，在锁内查找，调用方在锁外调用 D-Bus 方法
+std::shared_ptr<sdbus::IProxy> PlayerManager::currentProxy(const char *action,
+                                                           std::string &name) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  name = currentPlayer_;
+  if (name.empty()) {
+    WARN("No current player selected for %s", action);
+    return nullptr;
+  }
+  auto it = players_.find(name);
+  if (it == players_.end()) {
+    WARN("Current player proxy not found: %s", name.c_str());
+    return nullptr;
+  }
+  return it->second;
+}
+
+// 更新播放器状态信息（调用回调），调用方不持有 mutex_
+void PlayerManager::updatePlayerState(bool fetchMetadata) {
+  auto state = getPlayerState(fetchMetadata);
+  DEBUG("updatePlayerState: %s", state.playerName.c_str());
   if (stateCallback_) {
     stateCallback_(state);
   }
@@ -354,19 +432,15 @@ void PlayerManager::updatePlayerState() {
 
 // 播放/暂停切换
 void PlayerManager::togglePlayPause() {
-  if (currentPlayer_.empty()) {
-    WARN("No current player selected for play/pause toggle");
-    return;
-  }
-  auto it = players_.find(currentPlayer_);
-  if (it == players_.end()) {
-    WARN("Current player proxy not found: %s", currentPlayer_.c_str());
+  std::string player;
+  auto proxy = currentProxy("play/pause toggle", player);
+  if (!proxy) {
     return;
   }
   try {
-    it->second->callMethod("PlayPause")
+    proxy->callMethod("PlayPause")
         .onInterface("org.mpris.MediaPlayer2.Player");
-    INFO("Toggled play/pause for player: %s", currentPlayer_.c_str());
+    INFO("Toggled play/pause for player: %s", player.c_str());
   } catch (const sdbus::Error &e) {
     WARN("PlayPause failed: %s", e.what());
   }
@@ -374,18 +448,14 @@ void PlayerManager::togglePlayPause() {
 
 // 下一首歌曲
 void PlayerManager::nextSong() {
-  if (currentPlayer_.empty()) {
-    WARN("No current player selected for next song");
-    return;
-  }
-  auto it = players_.find(currentPlayer_);
-  if (it == players_.end()) {
-    WARN("Current player proxy not found: %s", currentPlayer_.c_str());
+  std::string player;
+  auto proxy = currentProxy("next song", player);
+  if (!proxy) {
     return;
   }
   try {
-    it->second->callMethod("Next").onInterface("org.mpris.MediaPlayer2.Player");
-    INFO("Next song triggered for player: %s", currentPlayer_.c_str());
+    proxy->callMethod("Next").onInterface("org.mpris.MediaPlayer2.Player");
+    INFO("Next song triggered for player: %s", player.c_str());
   } catch (const sdbus::Error &e) {
     WARN("Next song failed: %s", e.what());
   }
@@ -393,19 +463,15 @@ void PlayerManager::nextSong() {
 
 // 上一首歌曲
 void PlayerManager::prevSong() {
-  if (currentPlayer_.empty()) {
-    WARN("No current player selected for previous song");
-    return;
-  }
-  auto it = players_.find(currentPlayer_);
-  if (it == players_.end()) {
-    WARN("Current player proxy not found: %s", currentPlayer_.c_str());
+  std::string player;
+  auto proxy = currentProxy("previous song", player);
+  if (!proxy) {
     return;
   }
   try {
-    it->second->callMethod("Previous")
+    proxy->callMethod("Previous")
         .onInterface("org.mpris.MediaPlayer2.Player");
-    INFO("Previous song triggered for player: %s", currentPlayer_.c_str());
+    INFO("Previous song triggered for player: %s", player.c_str());
   } catch (const sdbus::Error &e) {
     WARN("Previous song failed: %s", e.what());
   }
@@ -413,18 +479,14 @@ void PlayerManager::prevSong() {
 
 // 停止播放
 void PlayerManager::stopPlayer() {
-  if (currentPlayer_.empty()) {
-    WARN("No current player selected for stop");
-    return;
-  }
-  auto it = players_.find(currentPlayer_);
-  if (it == players_.end()) {
-    WARN("Current player proxy not found: %s", currentPlayer_.c_str());
+  std::string player;
+  auto proxy = currentProxy("stop", player);
+  if (!proxy) {
     return;
   }
   try {
-    it->second->callMethod("Stop").onInterface("org.mpris.MediaPlayer2.Player");
-    INFO("Stopped player: %s", currentPlayer_.c_str());
+    proxy->callMethod("Stop").onInterface("org.mpris.MediaPlayer2.Player");
+    INFO("Stopped player: %s", player.c_str());
   } catch (const sdbus::Error &e) {
     WARN("Stop failed: %s", e.what());
   }
@@ -432,13 +494,9 @@ void PlayerManager::stopPlayer() {
 
 // 设置循环模式（需要在头文件中定义LoopStatus枚举）
 void PlayerManager::setLoopStatus(LoopStatus status) {
-  if (currentPlayer_.empty()) {
-    WARN("No current player selected for loop status");
-    return;
-  }
-  auto it = players_.find(currentPlayer_);
-  if (it == players_.end()) {
-    WARN("Current player proxy not found: %s", currentPlayer_.c_str());
+  std::string player;
+  auto proxy = currentProxy("loop status", player);
+  if (!proxy) {
     return;
   }
   const char *statusStr;
@@ -458,12 +516,12 @@ void PlayerManager::setLoopStatus(LoopStatus status) {
   }
   }
   try {
-    it->second->callMethod("Set")
+    proxy->callMethod("Set")
         .onInterface("org.freedesktop.DBus.Properties")
         .withArguments("org.mpris.MediaPlayer2.Player", "LoopStatus",
                        sdbus::Variant(statusStr));
     INFO("Set loop status to %s for player: %s", statusStr,
-         currentPlayer_.c_str());
+         player.c_str());
   } catch (const sdbus::Error &e) {
     WARN("Set loop status failed: %s", e.what());
   }
@@ -471,22 +529,18 @@ void PlayerManager::setLoopStatus(LoopStatus status) {
 
 // 设置随机播放
 void PlayerManager::setShuffle(bool enable) {
-  if (currentPlayer_.empty()) {
-    WARN("No current player selected for shuffle");
-    return;
-  }
-  auto it = players_.find(currentPlayer_);
-  if (it == players_.end()) {
-    WARN("Current player proxy not found: %s", currentPlayer_.c_str());
+  std::string player;
+  auto proxy = currentProxy("shuffle", player);
+  if (!proxy) {
     return;
   }
   try {
-    it->second->callMethod("Set")
+    proxy->callMethod("Set")
         .onInterface("org.freedesktop.DBus.Properties")
         .withArguments("org.mpris.MediaPlayer2.Player", "Shuffle",
                        sdbus::Variant(enable));
     INFO("Set shuffle %s for player: %s", enable ? "on" : "off",
-         currentPlayer_.c_str());
+         player.c_str());
     isShuffle_ = enable;
   } catch (const sdbus::Error &e) {
     WARN("Set shuffle failed: %s", e.what());
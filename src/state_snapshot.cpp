@@ -0,0 +1,88 @@
+#include "../include/state_snapshot.h"
+#include "../include/utils.hpp"
+#include "common.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// 文件格式（本机字节序）：[SnapHeader][字符串 × kFieldCount]，字符串按 lengths 的顺序排列
+static constexpr uint32_t kSnapMagic = 0x53534c57; // "WLSS"
+static constexpr uint16_t kSnapVersion = 1;
+static constexpr size_t kFieldCount = 5;
+static constexpr uint32_t kMaxFieldLength = 4096;
+
+struct SnapHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint8_t status;
+  uint8_t reserved;
+  int64_t length;
+  uint64_t position;
+  int64_t savedAt;
+  uint32_t lengths[kFieldCount];
+};
+
+bool StateSnapshot::load(const std::filesystem::path &dir, StateSnapshot &out) {
+  const auto path = dir / "state.snap";
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  std::string *fields[kFieldCount] = {&out.playerName, &out.title, &out.artist,
+                                      &out.musicBrainzId, &out.lyricsKey};
+  SnapHeader header{};
+  bool ok = pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+            header.magic == kSnapMagic && header.version == kSnapVersion &&
+            header.status <= static_cast<uint8_t>(PlaybackStatus::Unknown);
+  off_t offset = sizeof(header);
+  for (size_t i = 0; ok && i < kFieldCount; ++i) {
+    ok = header.lengths[i] <= kMaxFieldLength;
+    if (ok) {
+      fields[i]->resize(header.lengths[i]);
+      ok = pread(fd, fields[i]->data(), header.lengths[i], offset) ==
+           static_cast<ssize_t>(header.lengths[i]);
+      offset += header.lengths[i];
+    }
+  }
+  close(fd);
+  if (!ok) {
+    WARN("  >> Ignoring invalid state snapshot: %s", path.c_str());
+    return false;
+  }
+  out.status = static_cast<PlaybackStatus>(header.status);
+  out.length = header.length;
+  out.position = header.position;
+  out.savedAt = header.savedAt;
+  return true;
+}
+
+bool StateSnapshot::save(const std::filesystem::path &dir) const {
+  const std::string *fields[kFieldCount] = {&playerName, &title, &artist,
+                                            &musicBrainzId, &lyricsKey};
+  SnapHeader header{kSnapMagic, kSnapVersion, static_cast<uint8_t>(status),
+                    0,          length,       position,
+                    savedAt,    {}};
+  for (size_t i = 0; i < kFieldCount; ++i) {
+    if (fields[i]->size() > kMaxFieldLength) {
+      return false;
+    }
+    header.lengths[i] = fields[i]->size();
+  }
+  const auto path = dir / "state.snap";
+  const auto tmpPath = uniqueTmpPath(path);
+  int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  bool ok = writeAll(fd, &header, sizeof(header));
+  for (size_t i = 0; ok && i < kFieldCount; ++i) {
+    ok = writeAll(fd, fields[i]->data(), fields[i]->size());
+  }
+  close(fd);
+  ok = ok && rename(tmpPath.c_str(), path.c_str()) == 0;
+  if (!ok) {
+    unlink(tmpPath.c_str());
+    WARN("  >> Failed to write state snapshot: %s", path.c_str());
+  }
+  return ok;
+}
@@ -0,0 +1,368 @@
+#include "../include/track_key.h"
+#include <algorithm>
+#include <array>
+#include <vector>
+
+// ASCII 折叠表：字母转小写，数字保留，撇号删除（0），其余字符折叠为空格
+static constexpr std::array<char, 128> kAsciiFold = [] {
+  std::array<char, 128> table{};
+  for (int c = 0; c < 128; ++c) {
+    if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')) {
+      table[c] = char(c);
+    } else if (c >= 'A' && c <= 'Z') {
+      table[c] = char(c - 'A' + 'a');
+    } else if (c == '\'' || c == '`') {
+      table[c] = 0;
+    } else {
+      table[c] = ' ';
+    }
+  }
+  return table;
+}();
+
+// 版本限定中的关键字（" - Live"、"(2011 Remaster)" 等），按整词匹配
+static constexpr std::string_view kVersionWords[] = {
+    "live",    "remaster", "remastered", "version", "ver",          "edit",
+    "mix",     "remix",    "mono",       "stereo",  "acoustic",     "demo",
+    "instrumental", "radio", "feat",     "ft",      "featuring"};
+// 中文关键字没有词边界，匹配词尾（"现场版"、"伴奏"、"钢琴版"）
+static constexpr std::string_view kVersionSuffixes[] = {"伴奏", "现场", "版"};
+
+// 解码一个 UTF-8 字符，非法序列返回 U+FFFD
+static uint32_t decodeUtf8(std::string_view s, size_t &i) {
+  const unsigned char c = s[i++];
+  if (c < 0x80) {
+    return c;
+  }
+  const int extra = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : 0;
+  if (extra == 0 || i + extra > s.size()) {
+    return 0xFFFD;
+  }
+  uint32_t cp = c & (0x3F >> extra);
+  for (int k = 0; k < extra; ++k, ++i) {
+    const unsigned char cc = s[i];
+    if ((cc & 0xC0) != 0x80) {
+      return 0xFFFD;
+    }
+    cp = (cp << 6) | (cc & 0x3F);
+  }
+  return cp;
+}
+
+static void appendUtf8(std::string &out, uint32_t cp) {
+  if (cp < 0x80) {
+    out.push_back(char(cp));
+  } else if (cp < 0x800) {
+    out.push_back(char(0xC0 | (cp >> 6)));
+    out.push_back(char(0x80 | (cp & 0x3F)));
+  } else if (cp < 0x10000) {
+    out.push_back(char(0xE0 | (cp >> 12)));
+    out.push_back(char(0x80 | ((cp >> 6) & 0x3F)));
+    out.push_back(char(0x80 | (cp & 0x3F)));
+  } else {
+    out.push_back(char(0xF0 | (cp >> 18)));
+    out.push_back(char(0x80 | ((cp >> 12) & 0x3F)));
+    out.push_back(char(0x80 | ((cp >> 6) & 0x3F)));
+    out.push_back(char(0x80 | (cp & 0x3F)));
+  }
+}
+
+// 全角 ASCII 和全角空格转为半角
+static uint32_t foldWidth(uint32_t cp) {
+  if (cp >= 0xFF01 && cp <= 0xFF5E) {
+    return cp - 0xFEE0;
+  }
+  return cp == 0x3000 ? ' ' : cp;
+}
+
+static bool isOpenBracket(uint32_t cp) {
+  return cp == '(' || cp == '[' || cp == '{' || cp == 0x3010 /* 【 */ ||
+         cp == 0x3014 /* 〔 */ || cp == 0x3016 /* 〖 */;
+}
+
+static bool isCloseBracket(uint32_t cp) {
+  return cp == ')' || cp == ']' || cp == '}' || cp == 0x3011 ||
+         cp == 0x3015 || cp == 0x3017;
+}
+
+// 大小写与标点折叠：返回折叠后的字符，' ' 表示分隔符，0 表示删除
+static uint32_t foldChar(uint32_t cp) {
+  if (cp < 0x80) {
+    return static_cast<unsigned char>(kAsciiFold[cp]);
+  }
+  if (cp < 0x100) { // Latin-1：符号折叠为空格，À-Þ 转小写
+    if (cp < 0xC0 || cp == 0xD7 || cp == 0xF7) {
+      return ' ';
+    }
+    return cp <= 0xDE ? cp + 0x20 : cp;
+  }
+  if (cp < 0x180) { // Latin Extended-A：大小写成对排列
+    if (cp == 0x178) {
+      return 0xFF; // Ÿ
+    }
+    if (cp == 0x138 || cp == 0x149 || cp == 0x17F) {
+      return cp;
+    }
+    const bool oddUpper = (cp >= 0x139 && cp <= 0x148) || cp >= 0x179;
+    return (cp % 2 == 1) == oddUpper ? cp + 1 : cp;
+  }
+  if ((cp >= 0x391 && cp <= 0x3A9 && cp != 0x3A2) || // 希腊字母
+      (cp >= 0x410 && cp <= 0x42F)) {                // 西里尔字母
+    return cp + 0x20;
+  }
+  if (cp >= 0x400 && cp <= 0x40F) {
+    return cp + 0x50;
+  }
+  if (cp == 0x2018 || cp == 0x2019 || cp == 0x2032) {
+    return 0; // 弯撇号
+  }
+  if ((cp >= 0x2000 && cp <= 0x206F) ||                  // 通用标点
+      (cp >= 0x3000 && cp <= 0x303F && cp != 0x3005) ||  // CJK 标点（保留 々）
+      (cp >= 0xFE30 && cp <= 0xFE4F) ||                  // CJK 兼容形式
+      (cp >= 0xFF5F && cp <= 0xFF65) || cp == 0x30FB ||  // 半角括号、・
+      cp == 0xFFFD) {
+    return ' ';
+  }
+  return cp;
+}
+
+// 限定词中是否含有版本关键字（规范化后按空白分词，整词匹配）
+static bool hasVersionWord(std::string_view qualifier) {
+  const std::string folded = normalizeTitle(qualifier, false);
+  std::string_view rest = folded;
+  while (!rest.empty()) {
+    const size_t end = rest.find(' ');
+    const std::string_view token = rest.substr(0, end);
+    for (auto word : kVersionWords) {
+      if (token == word) {
+        return true;
+      }
+    }
+    for (auto suffix : kVersionSuffixes) {
+      if (token.ends_with(suffix)) {
+        return true;
+      }
+    }
+    if (end == std::string_view::npos) {
+      break;
+    }
+    rest.remove_prefix(end + 1);
+  }
+  return false;
+}
+
+static std::string_view trimRight(std::string_view s) {
+  while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) {
+    s.remove_suffix(1);
+  }
+  if (s.ends_with("\u3000")) { // 全角空格
+    return trimRight(s.substr(0, s.size() - 3));
+  }
+  return s;
+}
+
+// 末尾括号组的开始位置（"Song (Live)" 中 '(' 的偏移），没有时返回 npos
+static size_t trailingBracket(std::string_view title) {
+  // 记录每个字符的起始偏移和（全角转半角后的）码点，从后向前匹配括号
+  std::vector<std::pair<size_t, uint32_t>> chars;
+  for (size_t i = 0; i < title.size();) {
+    const size_t at = i;
+    chars.emplace_back(at, foldWidth(decodeUtf8(title, i)));
+  }
+  if (chars.empty() || !isCloseBracket(chars.back().second)) {
+    return std::string_view::npos;
+  }
+  int depth = 0;
+  for (size_t k = chars.size(); k-- > 0;) {
+    if (isCloseBracket(chars[k].second)) {
+      ++depth;
+    } else if (isOpenBracket(chars[k].second) && --depth == 0) {
+      return chars[k].first;
+    }
+  }
+  return std::string_view::npos;
+}
+
+std::string_view stripTitleQualifiers(std::string_view title) {
+  static constexpr std::string_view dashes[] = {" - ", " – ", " — ", " － "};
+  title = trimRight(title);
+  while (true) {
+    // 末尾的括号限定："Song (2011 Remaster)"、"Song【Live】"
+    const size_t open = trailingBracket(title);
+    if (open != std::string_view::npos && open > 0 &&
+        hasVersionWord(title.substr(open))) {
+      title = trimRight(title.substr(0, open));
+      continue;
+    }
+    // 最后一个破折号之后的限定："Song - Live"、"Song – 2011 Remaster"
+    size_t cut = std::string_view::npos, cutLength = 0;
+    for (auto dash : dashes) {
+      const size_t pos = title.rfind(dash);
+      if (pos != std::string_view::npos && pos > 0 &&
+          (cut == std::string_view::npos || pos > cut)) {
+        cut = pos;
+        cutLength = dash.size();
+      }
+    }
+    if (cut != std::string_view::npos && hasVersionWord(title.substr(cut + cutLength))) {
+      title = trimRight(title.substr(0, cut));
+      continue;
+    }
+    return title;
+  }
+}
+
+std::string normalizeTitle(std::string_view title, bool stripQualifiers) {
+  std::string_view source = stripQualifiers ? stripTitleQualifiers(title) : title;
+  std::string out;
+  out.reserve(source.size());
+  size_t i = 0;
+  while (i < source.size()) {
+    uint32_t cp = foldWidth(decodeUtf8(source, i));
+    if (isOpenBracket(cp) || isCloseBracket(cp)) {
+      cp = ' ';
+    } else {
+      cp = foldChar(cp);
+    }
+    if (cp == 0) {
+      continue;
+    }
+    if (cp == ' ') {
+      if (!out.empty() && out.back() != ' ') {
+        out.push_back(' ');
+      }
+      continue;
+    }
+    appendUtf8(out, cp);
+  }
+  if (!out.empty() && out.back() == ' ') {
+    out.pop_back();
+  }
+  if (stripQualifiers) {
+    // "Song feat. Someone"：从 feat 开始截断（不在开头时）
+    out.push_back(' ');
+    for (std::string_view word : {" feat ", " ft ", " featuring "}) {
+      size_t pos = out.find(word);
+      if (pos != std::string::npos) {
+        out.resize(pos + 1);
+      }
+    }
+    out.pop_back();
+    if (out.empty()) {
+      return normalizeTitle(title, false); // 整个标题都是限定词
+    }
+  }
+  return out;
+}
+
+std::string normalizeArtists(std::string_view artists) {
+  // 按分隔符拆分：ASCII , & / ; 以及全角/中文的 、，＆／；
+  static constexpr std::string_view wideSeparators[] = {"、", "，", "＆", "／",
+                                                        "；"};
+  std::vector<std::string> names;
+  auto addNames = [&names](std::string_view piece) {
+    // 规范化后再按 feat/ft/vs 拆分（"A feat. B"）
+    std::string name = normalizeTitle(piece, false);
+    size_t start = 0;
+    while (start <= name.size()) {
+      size_t end = name.size();
+      size_t skip = 0;
+      for (std::string_view word : {" feat ", " ft ", " featuring ", " vs "}) {
+        size_t pos = name.find(word, start);
+        if (pos != std::string::npos && pos < end) {
+          end = pos;
+          skip = word.size();
+        }
+      }
+      if (end > start) {
+        names.emplace_back(name, start, end - start);
+      }
+      if (skip == 0) {
+        break;
+      }
+      start = end + skip;
+    }
+  };
+  size_t begin = 0, i = 0;
+  while (i < artists.size()) {
+    size_t sepLength = 0;
+    const char c = artists[i];
+    if (c == ',' || c == '&' || c == '/' || c == ';') {
+      sepLength = 1;
+    } else if (static_cast<unsigned char>(c) >= 0x80) {
+      for (auto sep : wideSeparators) {
+        if (artists.substr(i).starts_with(sep)) {
+          sepLength = sep.size();
+          break;
+        }
+      }
+    }
+    if (sepLength == 0) {
+      ++i;
+      continue;
+    }
+    addNames(artists.substr(begin, i - begin));
+    i += sepLength;
+    begin = i;
+  }
+  addNames(artists.substr(begin));
+  // 同一组歌手的不同写法（顺序、重复）得到相同结果
+  std::sort(names.begin(), names.end());
+  names.erase(std::unique(names.begin(), names.end()), names.end());
+  std::string out;
+  for (const auto &name : names) {
+    if (!out.empty()) {
+      out.push_back(',');
+    }
+    out += name;
+  }
+  return out;
+}
+
+TrackKey TrackKey::make(std::string_view title, std::string_view artist,
+                        std::string_view musicBrainzId) {
+  TrackKey track;
+  track.title = normalizeTitle(title);
+  track.artist = normalizeArtists(artist);
+  std::string mbid;
+  for (char c : musicBrainzId) {
+    if (c != ' ' && c != '\t' && c != '\n') {
+      mbid.push_back(c >= 'A' && c <= 'Z' ? char(c - 'A' + 'a') : c);
+    }
+  }
+  if (!mbid.empty()) {
+    track.key = "mb:" + mbid;
+  } else if (!track.title.empty()) {
+    // 字段之间用 \x1f 分隔，避免 "a b"+"c" 与 "a"+"b c" 冲突。
+    // 时长不进入 key（不同播放器报告的时长有误差），查到缓存后再与记录的时长比较
+    track.key = track.title + '\x1f' + track.artist;
+  }
+  return track;
+}
+
+std::string TrackKey::searchText() const {
+  std::string text = title;
+  if (!artist.empty()) {
+    text += ' ';
+    text += artist;
+  }
+  std::replace(text.begin(), text.end(), ',', ' ');
+  return text;
+}
+
+std::string TrackKey::searchTextOf(std::string_view key) {
+  if (key.starts_with("mb:")) {
+    return {};
+  }
+  const size_t sep = key.find('\x1f');
+  if (sep == std::string_view::npos) {
+    // 旧版 key：原始的 "歌名 歌手"，空格被替换为下划线
+    std::string raw(key);
+    std::replace(raw.begin(), raw.end(), '_', ' ');
+    return normalizeTitle(raw, false);
+  }
+  TrackKey track;
+  track.title = key.substr(0, sep);
+  track.artist = key.substr(sep + 1);
+  return track.searchText();
+}
@@ -0,0 +1,299 @@
+#include "../include/trigram_index.h"
+#include "../include/track_key.h"
+#include "../include/utils.hpp"
+#include "common.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
+
+// 文件格式（本机字节序）：
+//   [TriHeader][KeyEntry × keyCount][GramEntry × (gramCount + 1)]
+//   [keyId × postingCount][key 字符串]
+// GramEntry 按三元组哈希排序，first 为倒排表在 postings 中的起点，最后一项为哨兵
+static constexpr uint32_t kTriMagic = 0x47544c57; // "WLTG"
+static constexpr uint16_t kTriVersion = 1;
+// 候选编号中标记增量 key（addedKeys_ 下标），索引文件中的 key 编号不会用到这一位
+static constexpr uint32_t kAddedBit = 1u << 31;
+
+struct TriHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t reserved;
+  uint32_t keyCount;
+  uint32_t gramCount;
+  uint32_t postingCount;
+  uint32_t keyBytes;
+};
+
+struct KeyEntry {
+  uint32_t offset; // 在 key 字符串区中的偏移
+  uint32_t length;
+};
+
+struct GramEntry {
+  uint32_t gram;
+  uint32_t first;
+};
+
+// 文本的三元组集合（按 UTF-8 字符切分，首尾补空格），返回排序去重后的哈希
+static std::vector<uint32_t> trigramsOf(std::string_view text) {
+  std::string padded;
+  padded.reserve(text.size() + 2);
+  padded.push_back(' ');
+  padded.append(text);
+  padded.push_back(' ');
+  std::vector<size_t> starts; // 每个字符的起始字节
+  for (size_t i = 0; i < padded.size(); ++i) {
+    if ((static_cast<unsigned char>(padded[i]) & 0xC0) != 0x80) {
+      starts.push_back(i);
+    }
+  }
+  starts.push_back(padded.size());
+  std::vector<uint32_t> grams;
+  for (size_t i = 0; i + 3 < starts.size(); ++i) {
+    std::string_view gram(padded.data() + starts[i], starts[i + 3] - starts[i]);
+    grams.push_back(static_cast<uint32_t>(hash64(gram)));
+  }
+  std::sort(grams.begin(), grams.end());
+  grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+  return grams;
+}
+
+TrigramIndex::TrigramIndex(const std::filesystem::path &dir)
+    : path_(dir / "lyrics.tri") {}
+
+bool TrigramIndex::indexable(std::string_view key) {
+  return !TrackKey::searchTextOf(key).empty();
+}
+
+void TrigramIndex::add(std::string_view key) {
+  if (!indexable(key)) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (std::find(addedKeys_.begin(), addedKeys_.end(), key) == addedKeys_.end()) {
+    addLocked(std::string(key));
+  }
+}
+
+void TrigramIndex::addLocked(std::string key) {
+  const uint32_t id = addedKeys_.size();
+  for (uint32_t gram : trigramsOf(TrackKey::searchTextOf(key))) {
+    addedPostings_[gram].push_back(id);
+  }
+  addedKeys_.push_back(std::move(key));
+}
+
+bool TrigramIndex::rebuild(const std::vector<std::string> &keys) {
+  std::vector<KeyEntry> entries;
+  std::vector<std::pair<uint32_t, uint32_t>> pairs; // (三元组, keyId)
+  std::string keyBytes;
+  for (const auto &key : keys) {
+    const std::string text = TrackKey::searchTextOf(key);
+    if (text.empty()) {
+      continue;
+    }
+    const uint32_t id = entries.size();
+    for (uint32_t gram : trigramsOf(text)) {
+      pairs.emplace_back(gram, id);
+    }
+    entries.push_back({static_cast<uint32_t>(keyBytes.size()),
+                       static_cast<uint32_t>(key.size())});
+    keyBytes.append(key);
+  }
+  std::sort(pairs.begin(), pairs.end());
+  std::vector<GramEntry> grams;
+  std::vector<uint32_t> postings;
+  postings.reserve(pairs.size());
+  for (const auto &[gram, id] : pairs) {
+    if (grams.empty() || grams.back().gram != gram) {
+      grams.push_back({gram, static_cast<uint32_t>(postings.size())});
+    }
+    postings.push_back(id);
+  }
+  const uint32_t gramCount = grams.size();
+  grams.push_back({UINT32_MAX, static_cast<uint32_t>(postings.size())}); // 哨兵
+
+  const TriHeader header{kTriMagic,
+                         kTriVersion,
+                         0,
+                         static_cast<uint32_t>(entries.size()),
+                         gramCount,
+                         static_cast<uint32_t>(postings.size()),
+                         static_cast<uint32_t>(keyBytes.size())};
+  const auto tmpPath = uniqueTmpPath(path_);
+  int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  bool ok = writeAll(fd, &header, sizeof(header)) &&
+            writeAll(fd, entries.data(), entries.size() * sizeof(KeyEntry)) &&
+            writeAll(fd, grams.data(), grams.size() * sizeof(GramEntry)) &&
+            writeAll(fd, postings.data(), postings.size() * sizeof(uint32_t)) &&
+            writeAll(fd, keyBytes.data(), keyBytes.size());
+  close(fd);
+  ok = ok && rename(tmpPath.c_str(), path_.c_str()) == 0;
+  if (!ok) {
+    unlink(tmpPath.c_str());
+    ERROR("  >> Failed to write trigram index: %s", path_.c_str());
+    return false;
+  }
+  {
+    // 增量中只保留读取 keys 之后才写入的 key
+    std::lock_guard<std::mutex> lock(mutex_);
+    const std::unordered_set<std::string_view> indexed(keys.begin(), keys.end());
+    std::vector<std::string> added;
+    added.swap(addedKeys_);
+    addedPostings_.clear();
+    for (auto &key : added) {
+      if (!indexed.contains(key)) {
+        addLocked(std::move(key));
+      }
+    }
+  }
+  DEBUG("  >> Trigram index rebuilt: %zu keys, %u trigrams", entries.size(),
+        gramCount);
+  return true;
+}
+
+bool TrigramIndex::refresh() {
+  int fd = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    map_.reset();
+    return false;
+  }
+  struct stat st;
+  TriHeader h;
+  bool ok = false;
+  if (fstat(fd, &st) != 0) {
+    ok = false;
+  } else if (map_ && static_cast<uint64_t>(st.st_ino) == inode_) {
+    ok = true; // 重建时 rename 替换，同一个 inode 的内容不会变化
+  } else if (pread(fd, &h, sizeof(h), 0) == sizeof(h) && h.magic == kTriMagic &&
+             h.version == kTriVersion &&
+             static_cast<uint64_t>(st.st_size) ==
+                 sizeof(h) + uint64_t(h.keyCount) * sizeof(KeyEntry) +
+                     (uint64_t(h.gramCount) + 1) * sizeof(GramEntry) +
+                     uint64_t(h.postingCount) * sizeof(uint32_t) + h.keyBytes) {
+    void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr != MAP_FAILED) {
+      const size_t size = st.st_size;
+      map_ = std::shared_ptr<const void>(
+          addr, [size](const void *p) { munmap(const_cast<void *>(p), size); });
+      inode_ = st.st_ino;
+      ok = true;
+    }
+  }
+  close(fd);
+  return ok;
+}
+
+size_t TrigramIndex::size() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!refresh()) {
+    return 0;
+  }
+  TriHeader h;
+  std::memcpy(&h, map_.get(), sizeof(h));
+  return h.keyCount;
+}
+
+std::vector<TrigramIndex::Match>
+TrigramIndex::search(std::string_view text, double threshold, size_t limit) {
+  std::vector<Match> matches;
+  const auto query = trigramsOf(text);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (query.empty()) {
+    return matches;
+  }
+  // 索引文件还不存在时只查询增量
+  TriHeader h{};
+  const KeyEntry *entries = nullptr;
+  const GramEntry *grams = nullptr;
+  const uint32_t *postings = nullptr;
+  const char *keyBytes = nullptr;
+  if (refresh()) {
+    auto *base = static_cast<const std::byte *>(map_.get());
+    std::memcpy(&h, base, sizeof(h));
+    entries = reinterpret_cast<const KeyEntry *>(base + sizeof(h));
+    grams = reinterpret_cast<const GramEntry *>(entries + h.keyCount);
+    postings = reinterpret_cast<const uint32_t *>(grams + h.gramCount + 1);
+    keyBytes = reinterpret_cast<const char *>(postings + h.postingCount);
+  }
+
+  // 1. 累计候选：过于常见的三元组（超过 5% 的 key）区分度低，跳过
+  const uint32_t maxPostings =
+      std::max<uint32_t>(64, (h.keyCount + addedKeys_.size()) / 20);
+  std::unordered_map<uint32_t, uint32_t> counts;
+  for (uint32_t gram : query) {
+    if (auto added = addedPostings_.find(gram);
+        added != addedPostings_.end() && added->second.size() <= maxPostings) {
+      for (uint32_t id : added->second) {
+        ++counts[id | kAddedBit];
+      }
+    }
+    if (!grams) {
+      continue;
+    }
+    auto it = std::lower_bound(
+        grams, grams + h.gramCount, gram,
+        [](const GramEntry &e, uint32_t g) { return e.gram < g; });
+    if (it == grams + h.gramCount || it->gram != gram) {
+      continue;
+    }
+    const uint32_t first = it->first, last = (it + 1)->first;
+    if (last - first > maxPostings || last > h.postingCount) {
+      continue;
+    }
+    for (uint32_t i = first; i < last; ++i) {
+      ++counts[postings[i]];
+    }
+  }
+  if (counts.empty()) {
+    return matches;
+  }
+
+  // 2. 对共享三元组最多的少量候选计算精确的 Dice 系数
+  std::vector<std::pair<uint32_t, uint32_t>> candidates(counts.begin(),
+                                                        counts.end());
+  const size_t verify = std::min(candidates.size(), limit * 2);
+  std::partial_sort(candidates.begin(), candidates.begin() + verify,
+                    candidates.end(),
+                    [](const auto &a, const auto &b) { return a.second > b.second; });
+  for (size_t i = 0; i < verify; ++i) {
+    const uint32_t id = candidates[i].first;
+    std::string key;
+    if (id & kAddedBit) {
+      key = addedKeys_[id & ~kAddedBit];
+    } else if (id < h.keyCount &&
+               entries[id].offset + uint64_t(entries[id].length) <= h.keyBytes) {
+      key.assign(keyBytes + entries[id].offset, entries[id].length);
+    } else {
+      continue;
+    }
+    if (std::any_of(matches.begin(), matches.end(),
+                    [&key](const Match &m) { return m.key == key; })) {
+      continue; // 重建前再次写入的 key 同时在索引文件和增量中
+    }
+    const auto keyGrams = trigramsOf(TrackKey::searchTextOf(key));
+    std::vector<uint32_t> common;
+    std::set_intersection(query.begin(), query.end(), keyGrams.begin(),
+                          keyGrams.end(), std::back_inserter(common));
+    const double score =
+        2.0 * common.size() / (query.size() + keyGrams.size());
+    if (score >= threshold) {
+      matches.push_back({std::move(key), score});
+    }
+  }
+  std::sort(matches.begin(), matches.end(),
+            [](const Match &a, const Match &b) { return a.score > b.score; });
+  if (matches.size() > limit) {
+    matches.resize(limit);
+  }
+  return matches;
+}
@@ -1,9 +1,14 @@
 #include "../include/way_lyrics.h"
+#include "../include/lyrics_document.h"
+#include "../include/lrclib.h"
+#include "../include/netease.h"
 #include "../include/utils.hpp"
 #include "common.h"
 #include "player_manager.h"
+#include <algorithm>
 #include <chrono>
 #include <cstddef>
+#include <cstring>
 #include <cstdint>
 #include <curl/curl.h>
 #include <filesystem>
@@ -13,6 +18,45 @@
 #include <memory>
 #include <nlohmann/json.hpp>
 #include <string>
+#include <sys/resource.h>
+#include <unistd.h>
+
+// 缓存包压缩检查的间隔
+static constexpr auto kMaintenanceInterval = std::chrono::minutes(30);
+// 网络出错后暂停后台刷新的时间（秒）
+static constexpr int64_t kNetworkBackoff = 10 * 60;
+// 等待刷新的歌曲上限
+static constexpr size_t kMaxRevalidations = 16;
+// 状态变化后延迟写入快照的时间，期间的变化合并为一次写入
+static constexpr auto kSnapshotDelay = std::chrono::seconds(2);
+// 模糊匹配的最低相似度（三元组 Dice 系数）
+static constexpr double kFuzzyThreshold = 0.75;
+// 超过该时间（毫秒）的状态快照不再使用
+static constexpr int64_t kSnapshotMaxAge = 12 * 3600 * 1000;
+
+static int64_t unixMillis() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+// 当前状态的快照（歌词以缓存包中的 key 记录）
+static StateSnapshot snapshotOf(const PlayerState &state) {
+  StateSnapshot snapshot;
+  snapshot.playerName = state.playerName;
+  snapshot.title = state.metadata.title;
+  snapshot.artist = state.metadata.artist;
+  snapshot.musicBrainzId = state.metadata.musicBrainzId;
+  snapshot.length = state.metadata.length;
+  if (state.metadata.lyrics) {
+    snapshot.lyricsKey = TrackKey::make(state.metadata.title, state.metadata.artist,
+                                        state.metadata.musicBrainzId).key;
+  }
+  snapshot.status = state.status;
+  snapshot.position = state.position;
+  snapshot.savedAt = unixMillis();
+  return snapshot;
+}
 
 void displayState(const PlayerState &state) {
     DEBUG("Current Player State:");
@@ -27,191 +71,653 @@ void displayState(const PlayerState &state) {
     //   DEBUG("    Album: %s", state.metadata.album.c_str());
 }
 
-WayLyrics::WayLyrics(const std::string &cacheDir, unsigned int updateInterval,
-                     const std::string &cssClass)
-    : updateInterval_(updateInterval), cssClass_(cssClass),
+WayLyrics::WayLyrics(const WayLyricsConfig &config)
+    : updateInterval_(config.updateInterval), cssClass_(config.cssClass),
+      showTranslation_(config.showTranslation),
+      cacheMaxBytes_(uint64_t(config.cacheMaxMb) * 1024 * 1024),
+      refreshAge_(int64_t(config.cacheRefreshDays) * 24 * 3600),
       isRunning_(false) {
   // 初始化缓存目录
-  cachePath = std::filesystem::path(cacheDir);
+  cachePath = std::filesystem::path(config.cacheDir);
+  lyricsPack_ = std::make_shared<LyricsPack>(cachePath);
+  missCache_ = std::make_unique<NegativeCache>(cachePath);
+  trigramIndex_ = std::make_unique<TrigramIndex>(cachePath);
+  cacheWriter_ = std::make_unique<CacheWriter>(lyricsPack_, 64, config.cacheSync);
+  fetchWorker_ = std::make_unique<FetchWorker>();
+  resolver_ = std::make_unique<LyricsResolver>(*fetchWorker_, makeProviders(config));
+  LyricsLru::shared().requestBudget(config.cacheMemoryKb * 1024);
+  // 先按快照显示上次的歌曲，播放器的实时状态在后台获取后再校正
+  restoreSnapshot();
+  maintenanceThread_ =
+      std::jthread([this](std::stop_token stop) { maintenanceLoop(stop); });
   // 初始化D-Bus连接和PlayerManager
   auto dbusUniqueConn = sdbus::createSessionBusConnection();
   dbusConn_ = std::shared_ptr<sdbus::IConnection>(dbusUniqueConn.release());
   playerManager_ = std::make_unique<PlayerManager>(dbusConn_, [this](const PlayerState &state) {
         DEBUG("  >> PlayerState updated: %s", state.playerName.c_str());
-        currentState_ = state;
-        // 如果歌词为空且状态为播放中，则尝试获取歌词
-        if (currentState_.metadata.lyrics.empty() &&
-            currentState_.status == PlaybackStatus::Playing) {
+        PlayerState newState = state; // 歌词文档通过 shared_ptr 共享，不拷贝内容
+        if (!resolver_->enabled("player")) {
+          newState.metadata.lyrics.reset(); // 没有启用 player 来源
+        }
+        const bool playerLyrics = newState.metadata.lyrics != nullptr;
+        std::shared_ptr<const RenderPlan> plan;
+        bool writeThrough = false;
+        {
+          // 同一首歌的状态变化（暂停/继续、跳转）沿用已获取的歌词，不再查询缓存
+          std::lock_guard<std::mutex> lock(stateMutex_);
+          if (!playerLyrics &&
+              currentState_.playerName == newState.playerName &&
+              currentState_.metadata.title == newState.metadata.title &&
+              currentState_.metadata.artist == newState.metadata.artist) {
+            newState.metadata.lyrics = currentState_.metadata.lyrics;
+          }
+          plan = renderPlan_;
+          // 播放器提供的歌词（同一个文档只处理一次）写入缓存
+          writeThrough = playerLyrics &&
+                         writtenThrough_.lock() != newState.metadata.lyrics;
+          if (writeThrough) {
+            writtenThrough_ = newState.metadata.lyrics;
+          }
+        }
+        if (writeThrough) {
+          cachePlayerLyrics(newState.metadata);
+        }
+        // 播放器提供了歌词，或歌词为空且状态为播放中时，按配置的来源顺序获取歌词
+        if (playerLyrics || (!newState.metadata.lyrics &&
+                             newState.status == PlaybackStatus::Playing)) {
             DEBUG("  >> Fetching lyrics for: %s by %s",
-                  currentState_.metadata.title.c_str(),
-                  currentState_.metadata.artist.c_str());
+                  newState.metadata.title.c_str(),
+                  newState.metadata.artist.c_str());
             try {
-              currentState_.metadata.lyrics = getLyrics(
-                  currentState_.metadata.title, currentState_.metadata.artist);
-              if (currentState_.metadata.lyrics.empty()) {
-                currentState_.metadata.lyrics =
-                    getLyrics(currentState_.metadata.title, "");
-              }
+              // 所有缓存层和网络查询使用同一个规范化的歌曲标识
+              const TrackKey track = TrackKey::make(
+                  newState.metadata.title, newState.metadata.artist,
+                  newState.metadata.musicBrainzId);
+              // 本地来源都未命中时提交异步网络请求，不阻塞 D-Bus 事件循环
+              newState.metadata.lyrics = getLyrics(track, newState.metadata);
             } catch (const std::exception &e) {
               WARN("  >> Failed to get lyrics: %s", e.what());
             }
         }
-        currentState_.position += 200; // 微调预览歌词的时间
+        newState.position += 200; // 微调预览歌词的时间
+        // 歌曲或歌词变化时重建显示内容，状态变化沿用原有的
+        if (!plan || plan->lyrics != newState.metadata.lyrics ||
+            plan->title != newState.metadata.title ||
+            plan->artist != newState.metadata.artist) {
+          plan = RenderPlan::build(newState.metadata, showTranslation_);
+        }
+        saveSnapshot(newState);
+        std::lock_guard<std::mutex> lock(stateMutex_);
+        currentState_ = std::move(newState);
+        renderPlan_ = std::move(plan);
       });
   
   INFO("  >> WayLyrics initialized"
-       " with cache path: %s, update interval: %u seconds, CSS class: %s",
-       cachePath.c_str(), updateInterval_, cssClass_.c_str());
+       " with cache path: %s, update interval: %u seconds, CSS class: %s, providers: %s",
+       cachePath.c_str(), updateInterval_, cssClass_.c_str(), resolver_->names().c_str());
 }
+void WayLyrics::logStats() {
+  LyricsLru::shared().logStats();
+  lyricsPack_->logStats();
+  INFO("  >> Negative cache: %zu entries", missCache_->size());
+  resolver_->logStats();
+}
+
 WayLyrics::~WayLyrics() {
+  logStats();
   INFO("  >> WayLyrics destroyed");
   playerManager_.reset();
+  // 维护线程可能正在刷新歌词并写入缓存，先于写入线程停止
+  maintenanceThread_.request_stop();
+  if (maintenanceThread_.joinable()) {
+    maintenanceThread_.join();
+  }
+  {
+    // 维护线程已停止，直接写入最后的状态（刷新线程推算的当前位置）
+    std::unique_lock<std::mutex> lock(stateMutex_);
+    PlayerState state = currentState_;
+    lock.unlock();
+    snapshotOf(state).save(cachePath);
+  }
+  shuttingDown_ = true;
+  fetchWorker_.reset(); // 未完成的网络请求以取消完成
+  resolver_.reset();    // 请求线程已停止，不再有回调引用歌词来源
+  cacheWriter_.reset(); // 写完队列中的歌词
   stop();
 }
-std::string WayLyrics::getLyrics(const std::string &trackName, const std::string &artist="") {
-  std::string trim_query = trackName + " " + artist;
-  trim_query = trim(trim_query);
-  if(trim_query.empty()) {
-    return "";
-  }
-  std::string url =
-      "https://lrclib.net/api/search?track_name=" + url_encode(trackName);
-
-  // 如果提供了艺术家名称，添加到URL中
-  if(!artist.empty())
-      url += "&artist_name=" + url_encode(artist);
-
-  std::filesystem::path lyricsCachePath =
-      cachePath / std::string(replace_space(trim_query) + ".txt");
-  std::string content;
-
-  std::string syncedLyrics = "";
-  if (std::filesystem::exists(lyricsCachePath)) {
-    DEBUG("  >> Lyrics found in cache: %s", lyricsCachePath.c_str());
-    std::ifstream file(lyricsCachePath, std::ios::binary);
-    if (!file.is_open()) {
-      ERROR("  >> Failed to open cache file: %s", lyricsCachePath.c_str());
-      return "";
-    }
-    return std::string(std::istreambuf_iterator<char>(file), {});
-  } else {
-    DEBUG("  >> Lyrics not found in cache[%s], fetching from: %s",
-          lyricsCachePath.c_str() , url.c_str());
-    CURL *curl = curl_easy_init();
-    if (curl) {
-      curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-      curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-      curl_easy_setopt(curl, CURLOPT_WRITEDATA, &content);
-      CURLcode res = curl_easy_perform(curl);
-
-      if (res != CURLE_OK) {
-        ERROR("  >> CURL error: %s", curl_easy_strerror(res));
-        return "";
+std::shared_ptr<const LyricsDocument>
+WayLyrics::getLyrics(const TrackKey &track, const PlayerMetadata &metadata) {
+  if (track.key.empty()) {
+    return metadata.lyrics;
+  }
+  const LyricsQuery query{track, metadata.title, metadata.artist, metadata.album,
+                          metadata.length, metadata.lyrics};
+  if (auto lyrics = resolver_->resolveLocal(query)) {
+    // 歌词只在获取时解析一次，之后各线程共享同一个文档
+    LyricsLru::shared().put(track.key, lyrics);
+    return lyrics;
+  }
+  if (!resolver_->hasRemote()) {
+    return nullptr;
+  }
+  // 已知没有歌词的歌曲在有效期内不再发起请求
+  LyricsMiss miss = LyricsMiss::NotFound;
+  if (missCache_->contains(track.key, &miss)) {
+    DEBUG("  >> Lyrics known missing (reason %d): %s", static_cast<int>(miss),
+          track.key.c_str());
+    return nullptr;
+  }
+  // 网络请求在请求线程中进行，获取到后再更新显示
+  fetchTrack(query, [this, track](std::shared_ptr<const LyricsDocument> lyrics,
+                                  LyricsMiss) {
+    if (lyrics) {
+      publishLyrics(track, std::move(lyrics));
+    }
+  });
+  return nullptr;
+}
+
+// 缓存歌词的时长与播放器报告的时长是否相符（未知时视为相符）：
+// 依次比较缓存记录的时长、歌词的 [length:] 标签，
+// 都没有时至少最后一行不能晚于歌曲结束
+static bool lengthMatches(const LyricsDocument &lyrics, int64_t recordLengthMs,
+                          int64_t lengthMs) {
+  if (lengthMs <= 0) {
+    return true;
+  }
+  if (recordLengthMs > 0) {
+    return std::abs(recordLengthMs - lengthMs) <= kLengthTolerance;
+  }
+  if (lyrics.lengthMs() > 0) {
+    return std::abs(int64_t(lyrics.lengthMs()) - lengthMs) <= kLengthTolerance;
+  }
+  return lyrics.empty() ||
+         int64_t(lyrics.line(lyrics.size() - 1).startMs) <= lengthMs + kLengthTolerance;
+}
+
+std::shared_ptr<const LyricsDocument> WayLyrics::findCached(const LyricsQuery &query) {
+  const TrackKey &track = query.track;
+  // 先查进程内 LRU（按歌曲标识，与播放器无关），未命中再查缓存包；
+  // key 中不含时长，命中后排除时长不符的其他版本（现场版等）
+  if (auto lyrics = LyricsLru::shared().get(track.key);
+      lyrics && lengthMatches(*lyrics, 0, query.lengthMs)) {
+    return lyrics;
+  }
+  LyricsPack::RecordInfo info;
+  if (auto lyrics = lyricsPack_->find(track.key, &info)) {
+    if (lengthMatches(*lyrics, info.lengthMs, query.lengthMs)) {
+      DEBUG("  >> Lyrics found in cache: %s", track.key.c_str());
+      // 先显示缓存，过期时在后台刷新（播放器提供的歌词不需要刷新）
+      if (info.source != LyricsSource::Player) {
+        scheduleRevalidation(query, info.storedAt);
       }
-      long http_code = 0;
-      curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
-      if (http_code != 200) {
-        ERROR("  >> HTTP error: %ld", http_code);
-        return "";
+      return lyrics;
+    }
+    DEBUG("  >> Cached lyrics are for another length (%lld ms): %s",
+          (long long)info.lengthMs, track.key.c_str());
+  }
+  // 旧版缓存 key：只读兼容，命中后以规范 key 重新保存。
+  // 依次为原始的 "歌名 歌手"、只有歌名（空格替换为下划线）
+  std::string artistTitle = query.title + " " + query.artist, title = query.title;
+  const std::string legacyKeys[] = {replace_space(trim(artistTitle)),
+                                    replace_space(trim(title))};
+  for (const auto &legacyKey : legacyKeys) {
+    if (legacyKey.empty()) {
+      continue;
+    }
+    // 只有歌名的 key 可能是同名的其他歌曲，时长不符时不采用，也不提升为规范 key
+    auto lyrics = lyricsPack_->find(legacyKey, &info);
+    if (lyrics && lengthMatches(*lyrics, info.lengthMs, query.lengthMs)) {
+      DEBUG("  >> Lyrics found in cache by legacy key: %s", legacyKey.c_str());
+      storeLyrics(track.key, lyrics, query.lengthMs, info.source);
+      return lyrics;
+    }
+  }
+  // 精确 key 未命中：在已缓存的歌曲中做模糊匹配（拼写差异、不同播放器的标签习惯）
+  return findSimilar(track, query.lengthMs);
+}
+
+std::vector<std::unique_ptr<LyricsProvider>>
+WayLyrics::makeProviders(const WayLyricsConfig &config) {
+  std::vector<std::unique_ptr<LyricsProvider>> providers;
+  for (const auto &name : config.providers) {
+    if (std::any_of(providers.begin(), providers.end(),
+                    [&name](const auto &p) { return p->info().name == name; })) {
+      continue;
+    }
+    if (name == "player") {
+      providers.push_back(std::make_unique<LocalProvider>(
+          name, [](const LyricsQuery &query) { return query.playerLyrics; }));
+    } else if (name == "cache") {
+      providers.push_back(std::make_unique<LocalProvider>(
+          name, [this](const LyricsQuery &query) { return findCached(query); }));
+    } else if (name == "lrclib") {
+      providers.push_back(std::make_unique<LrclibProvider>(*fetchWorker_, config.lrclibUrl));
+    } else if (name == "netease") {
+      providers.push_back(std::make_unique<NeteaseProvider>(*fetchWorker_, config.neteaseUrl));
+    } else {
+      WARN("  >> Unknown lyrics provider: %s", name.c_str());
+    }
+  }
+  return providers;
+}
+
+// 两份歌词的编译数据是否相同
+static bool sameLyrics(const std::shared_ptr<const LyricsDocument> &a,
+                       const std::shared_ptr<const LyricsDocument> &b) {
+  return a && b && a->byteSize() == b->byteSize() &&
+         std::memcmp(a->data(), b->data(), a->byteSize()) == 0;
+}
+
+void WayLyrics::fetchTrack(const LyricsQuery &query, LyricsCallback done) {
+  const TrackKey &track = query.track;
+  {
+    std::lock_guard<std::mutex> lock(fetchMutex_);
+    auto [it, inserted] = inflight_.try_emplace(track.key);
+    it->second.push_back(std::move(done));
+    if (!inserted) {
+      // 同一首歌已在请求中（同一次切歌的多次 PropertiesChanged、后台刷新）
+      DEBUG("  >> Joining in-flight lyrics request: %s", track.key.c_str());
+      return;
+    }
+  }
+  DEBUG("  >> Lyrics not found in cache, fetching: %s - %s",
+        track.title.c_str(), track.artist.c_str());
+  resolver_->resolveRemote(query, [this, query](std::shared_ptr<const LyricsDocument> lyrics,
+                                                LyricsMiss miss) {
+    onTrackFetched(query, std::move(lyrics), miss);
+  });
+}
+
+void WayLyrics::onTrackFetched(const LyricsQuery &query,
+                               std::shared_ptr<const LyricsDocument> lyrics,
+                               LyricsMiss miss) {
+  const TrackKey &track = query.track;
+  std::vector<LyricsCallback> waiters;
+  {
+    std::lock_guard<std::mutex> lock(fetchMutex_);
+    if (auto node = inflight_.extract(track.key)) {
+      waiters = std::move(node.mapped());
+    }
+  }
+  // 结果只保存一次，再分发给所有等待者；与缓存内容相同（后台刷新）时
+  // 只更新记录的写入时间，不追加重复的记录
+  if (lyrics) {
+    if (!sameLyrics(lyricsPack_->find(track.key), lyrics) ||
+        !lyricsPack_->touch(track.key)) {
+      storeLyrics(track.key, lyrics, query.lengthMs);
+    }
+  } else if (!shuttingDown_) { // 退出时被取消的请求不记录为缺失
+    if (miss == LyricsMiss::NetworkError) {
+      lastNetworkError_ = std::time(nullptr);
+    }
+    if (!lyricsPack_->find(track.key)) { // 后台刷新失败时保留原有缓存
+      missCache_->record(track.key, miss);
+    }
+  }
+  for (auto &waiter : waiters) {
+    waiter(lyrics, miss);
+  }
+}
+
+void WayLyrics::publishLyrics(const TrackKey &track,
+                              std::shared_ptr<const LyricsDocument> lyrics) {
+  LyricsLru::shared().put(track.key, lyrics);
+  // 请求期间可能已切换歌曲：只更新仍在显示、还没有歌词的同一首歌
+  auto isCurrent = [this, &track] {
+    const auto &md = currentState_.metadata;
+    return !md.lyrics &&
+           TrackKey::make(md.title, md.artist, md.musicBrainzId).key == track.key;
+  };
+  PlayerMetadata metadata;
+  {
+    std::lock_guard<std::mutex> lock(stateMutex_);
+    if (!isCurrent()) {
+      return;
+    }
+    metadata = currentState_.metadata;
+  }
+  metadata.lyrics = lyrics;
+  auto plan = RenderPlan::build(metadata, showTranslation_); // 不持有锁构建
+  PlayerState state;
+  {
+    std::lock_guard<std::mutex> lock(stateMutex_);
+    if (!isCurrent()) {
+      return;
+    }
+    currentState_.metadata.lyrics = std::move(lyrics);
+    renderPlan_ = std::move(plan);
+    state = currentState_;
+  }
+  DEBUG("  >> Lyrics fetched and published: %s", track.key.c_str());
+  saveSnapshot(state);
+}
+
+std::shared_ptr<const LyricsDocument>
+WayLyrics::findSimilar(const TrackKey &track, int64_t lengthMs) {
+  const auto start = std::chrono::steady_clock::now();
+  for (const auto &match : trigramIndex_->search(track.searchText(), kFuzzyThreshold)) {
+    if (match.key == track.key) {
+      continue;
+    }
+    LyricsPack::RecordInfo info;
+    auto lyrics = lyricsPack_->find(match.key, &info);
+    if (lyrics && lengthMatches(*lyrics, info.lengthMs, lengthMs)) {
+      DEBUG("  >> Fuzzy cache hit (%.2f, %.3f ms): %s", match.score,
+            std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count(),
+            match.key.c_str());
+      return lyrics;
+    }
+  }
+  return nullptr;
+}
+
+void WayLyrics::cachePlayerLyrics(const PlayerMetadata &metadata) {
+  const TrackKey track =
+      TrackKey::make(metadata.title, metadata.artist, metadata.musicBrainzId);
+  if (track.key.empty() || !metadata.lyrics || metadata.lyrics->empty()) {
+    return;
+  }
+  // 同一首歌在其他播放器中播放时直接使用，不再查询网络
+  LyricsLru::shared().put(track.key, metadata.lyrics);
+  LyricsPack::RecordInfo info;
+  auto cached = lyricsPack_->find(track.key, &info);
+  if (info.source == LyricsSource::Player && sameLyrics(cached, metadata.lyrics)) {
+    return; // 已经缓存过（本地缓存先于负缓存查询，不必删除缺失记录）
+  }
+  missCache_->erase(track.key);
+  DEBUG("  >> Caching lyrics supplied by the player: %s", track.key.c_str());
+  storeLyrics(track.key, metadata.lyrics, metadata.length, LyricsSource::Player);
+}
+
+void WayLyrics::restoreSnapshot() {
+  const auto start = std::chrono::steady_clock::now();
+  StateSnapshot snapshot;
+  if (!StateSnapshot::load(cachePath, snapshot) || snapshot.playerName.empty()) {
+    return;
+  }
+  const int64_t elapsed = unixMillis() - snapshot.savedAt;
+  if (elapsed < 0 || elapsed > kSnapshotMaxAge) {
+    return;
+  }
+  PlayerState state{snapshot.status, {}, snapshot.position, snapshot.playerName};
+  state.metadata.title = snapshot.title;
+  state.metadata.artist = snapshot.artist;
+  state.metadata.length = snapshot.length;
+  state.metadata.musicBrainzId = snapshot.musicBrainzId;
+  if (state.status == PlaybackStatus::Playing) {
+    state.position += elapsed; // 退出期间歌曲仍在播放
+    if (state.metadata.length > 0 &&
+        state.position > uint64_t(state.metadata.length)) {
+      return; // 这首歌已经播放完了
+    }
+  }
+  // 只读内存 LRU 和缓存包（mmap），不访问网络
+  if (!snapshot.lyricsKey.empty()) {
+    auto &lru = LyricsLru::shared();
+    state.metadata.lyrics = lru.get(snapshot.lyricsKey);
+    if (!state.metadata.lyrics) {
+      state.metadata.lyrics = lyricsPack_->find(snapshot.lyricsKey);
+      if (!state.metadata.lyrics) {
+        const TrackKey track =
+            TrackKey::make(snapshot.title, snapshot.artist, snapshot.musicBrainzId);
+        state.metadata.lyrics = findSimilar(track, snapshot.length);
       }
-      if (content.empty()) {
-        ERROR("  >> No content received");
-        return "";
+      if (state.metadata.lyrics) {
+        lru.put(snapshot.lyricsKey, state.metadata.lyrics);
       }
-      curl_easy_cleanup(curl);
     }
   }
+  auto plan = RenderPlan::build(state.metadata, showTranslation_);
+  {
+    std::lock_guard<std::mutex> lock(stateMutex_);
+    currentState_ = std::move(state);
+    renderPlan_ = std::move(plan);
+  }
+  INFO("  >> State snapshot restored in %.3f ms: %s",
+       std::chrono::duration<double, std::milli>(
+           std::chrono::steady_clock::now() - start).count(),
+       snapshot.title.c_str());
+}
 
-  try {
-    auto json = nlohmann::json::parse(content, nullptr, false);
-    if (json.is_discarded())
-      return "";
-
-    auto currentLyrics = json.get<std::vector<nlohmann::json>>();
-    if (currentLyrics.empty())
-      return "";
-    auto &first = currentLyrics[0];
-    if (first.count("syncedLyrics")) {
-      syncedLyrics = first["syncedLyrics"];
-
-      if (!syncedLyrics.empty()) {
-        std::thread([lyricsCachePath, syncedLyrics]() {
-            std::ofstream file(lyricsCachePath,
-                               std::ios::out | std::ios::trunc);
-            if (!file.is_open()) {
-              ERROR("  >> Failed to open cache file for writing: %s",
-                    lyricsCachePath.c_str());
-              return;
-            }
-            file << syncedLyrics;
-            if (file.fail()) {
-              ERROR("  >> Failed to write lyrics to cache file: %s",
-                    lyricsCachePath.c_str());
-              return;
-            }
-            DEBUG("  >> Lyrics cached successfully to: %s", lyricsCachePath.c_str());
-        }).detach();
+void WayLyrics::saveSnapshot(const PlayerState &state) {
+  StateSnapshot snapshot = snapshotOf(state);
+  {
+    std::lock_guard<std::mutex> lock(maintenanceMutex_);
+    if (!pendingSnapshot_) {
+      snapshotDue_ = std::chrono::steady_clock::now() + kSnapshotDelay;
+      snapshotScheduled_ = true;
+    }
+    pendingSnapshot_ = std::move(snapshot);
+  }
+  maintenanceCv_.notify_one();
+}
+
+void WayLyrics::scheduleRevalidation(const LyricsQuery &query, int64_t storedAt) {
+  const int64_t now = std::time(nullptr);
+  if (refreshAge_ <= 0 || !resolver_->hasRemote() || now - storedAt < refreshAge_ ||
+      now - lastNetworkError_.load() < kNetworkBackoff) {
+    return; // 未过期，或网络最近出错
+  }
+  {
+    std::lock_guard<std::mutex> lock(maintenanceMutex_);
+    // 每首歌每次运行只刷新一次，刷新失败时继续使用缓存
+    if (revalidateQueue_.size() >= kMaxRevalidations ||
+        !revalidated_.insert(query.track.key).second) {
+      return;
+    }
+    revalidateQueue_.push_back(query);
+  }
+  maintenanceCv_.notify_one();
+}
+
+void WayLyrics::revalidate(const LyricsQuery &query, std::stop_token stop) {
+  const TrackKey &track = query.track;
+  auto cached = lyricsPack_->find(track.key); // 请求结束时新歌词可能已写入
+  // 结果由请求线程写入；退出时不等待请求完成（之后以取消完成，回调只持有 result）
+  struct Result {
+    std::mutex mutex;
+    std::condition_variable_any cv;
+    bool done = false;
+    std::shared_ptr<const LyricsDocument> lyrics;
+  };
+  auto result = std::make_shared<Result>();
+  fetchTrack(query, [result](std::shared_ptr<const LyricsDocument> lyrics, LyricsMiss) {
+    {
+      std::lock_guard<std::mutex> lock(result->mutex);
+      result->lyrics = std::move(lyrics);
+      result->done = true;
+    }
+    result->cv.notify_one();
+  });
+  std::shared_ptr<const LyricsDocument> lyrics;
+  {
+    std::unique_lock<std::mutex> lock(result->mutex);
+    if (!result->cv.wait(lock, stop, [&result] { return result->done; })) {
+      return; // 维护线程被要求停止
+    }
+    lyrics = std::move(result->lyrics);
+  }
+  if (!lyrics) {
+    DEBUG("  >> Revalidation found nothing, keeping cached lyrics: %s",
+          track.key.c_str());
+    return;
+  }
+  // 新歌词已由 onTrackFetched 写入（内容不变时只更新写入时间）
+  if (!sameLyrics(cached, lyrics)) {
+    // 正在显示的歌词不变，下次播放时使用新版本
+    LyricsLru::shared().put(track.key, lyrics);
+    INFO("  >> Cached lyrics updated: %s", track.key.c_str());
+  }
+}
+
+void WayLyrics::maintenanceLoop(std::stop_token stop) {
+  // 后台维护线程（最低优先级）：导入旧版缓存（每个查询一个 .txt 文件），
+  // 之后定期压缩缓存包并按磁盘预算淘汰最久未使用的歌词，
+  // 空闲时刷新过期的缓存歌词
+  setpriority(PRIO_PROCESS, gettid(), 19);
+  lyricsPack_->migrate(cachePath, stop);
+  auto nextCompaction = std::chrono::steady_clock::now();
+  while (!stop.stop_requested()) {
+    if (std::chrono::steady_clock::now() >= nextCompaction) {
+      lyricsPack_->compact(cacheMaxBytes_, stop);
+      // 缓存中可索引的 key 数变化后重建模糊匹配索引（合并增量、去掉被淘汰的 key）
+      if (!stop.stop_requested()) {
+        auto keys = lyricsPack_->keys();
+        std::erase_if(keys, [](const std::string &key) {
+          return !TrigramIndex::indexable(key);
+        });
+        if (keys.size() != trigramIndex_->size()) {
+          trigramIndex_->rebuild(keys);
+        }
       }
-      return syncedLyrics;
-    }else {
-      WARN("  >> No syncedLyrics found in JSON");
-      return "";
-    } 
-  }catch (const std::exception &e) {
-    WARN("Error parsing JSON: %s", e.what());
-    return "";
-  }
-  return "";
+      nextCompaction = std::chrono::steady_clock::now() + kMaintenanceInterval;
+    }
+    std::optional<LyricsQuery> query;
+    std::optional<StateSnapshot> snapshot;
+    {
+      std::unique_lock<std::mutex> lock(maintenanceMutex_);
+      const auto wakeAt =
+          pendingSnapshot_ ? std::min(nextCompaction, snapshotDue_) : nextCompaction;
+      maintenanceCv_.wait_until(lock, stop, wakeAt, [this] {
+        return !revalidateQueue_.empty() || snapshotScheduled_;
+      });
+      snapshotScheduled_ = false;
+      if (pendingSnapshot_ && std::chrono::steady_clock::now() >= snapshotDue_) {
+        snapshot = std::move(pendingSnapshot_);
+        pendingSnapshot_.reset();
+      }
+      if (!revalidateQueue_.empty()) {
+        query = std::move(revalidateQueue_.front());
+        revalidateQueue_.pop_front();
+      }
+    }
+    if (snapshot) {
+      snapshot->save(cachePath);
+    }
+    if (query && !stop.stop_requested()) {
+      revalidate(*query, stop);
+    }
+  }
+}
+
+void WayLyrics::storeLyrics(const std::string &key,
+                            std::shared_ptr<const LyricsDocument> lyrics,
+                            int64_t lengthMs, LyricsSource source) {
+  cacheWriter_->enqueue(key, std::move(lyrics), source, lengthMs);
+  trigramIndex_->add(key);
+}
+
+// 转义 Pango 标记中的特殊字符
+static std::string escapeMarkup(std::string_view text) {
+  gchar *escaped = g_markup_escape_text(text.data(), text.size());
+  std::string result(escaped);
+  g_free(escaped);
+  return result;
 }
-// 静态方法：提取指定时间戳的歌词行
-static std::string getSyncedLine(uint64_t pos, const std::string &syncedLyrics) {
-  auto strVec = split(syncedLyrics, "\n");
-  auto len = strVec.size();
-  DEBUG("  >> getSyncedLine: pos=%ld, len=%ld", pos, len);
-  size_t index = 0;
-  for (size_t i = 0; i < len; i++) {
-    auto &cur = strVec[i];
-    if (cur.empty()) {
+
+std::shared_ptr<const RenderPlan>
+RenderPlan::build(const PlayerMetadata &metadata, bool translation) {
+  auto plan = std::make_shared<RenderPlan>();
+  plan->lyrics = metadata.lyrics;
+  plan->title = metadata.title;
+  plan->artist = metadata.artist;
+  if (!metadata.title.empty()) {
+    plan->prefix = "《" + metadata.title + "》" + metadata.artist + " - ";
+  } else {
+    plan->prefix = "[no title]" + metadata.artist + " - ";
+  }
+  plan->prefixMarkup = escapeMarkup(plan->prefix);
+  const auto &lyrics = metadata.lyrics;
+  if (!lyrics) {
+    return plan;
+  }
+  plan->lines.resize(lyrics->size());
+  for (size_t i = 0; i < lyrics->size(); ++i) {
+    std::string_view text = lyrics->text(i); // 文档中的文本已去除首尾空白
+    std::string_view sub = translation ? lyrics->subText(i) : std::string_view{};
+    std::string &line = plan->lines[i];
+    line.reserve(text.size() + (sub.empty() ? 0 : sub.size() + 3));
+    line.append(text);
+    if (!sub.empty()) {
+      line.append(" / ").append(sub);
+    }
+    // 逐字行：每个字预先生成一条完整标记（当前字加下划线），
+    // 多个时间戳共享的行共享同一段字表，只生成一次
+    const auto &l = lyrics->line(i);
+    if (l.wordCount == 0) {
       continue;
     }
-    uint64_t ms = timestampToMs(cur);
-    if (pos > ms) {
-        index = i;
-    } else {
-      break;
+    if (plan->wordMarkup.size() < l.wordBegin + l.wordCount) {
+      plan->wordMarkup.resize(l.wordBegin + l.wordCount);
+    }
+    const LyricsWord *words = lyrics->words(i);
+    const std::string subMarkup = sub.empty() ? "" : " / " + escapeMarkup(sub);
+    for (size_t w = 0; w < l.wordCount; ++w) {
+      std::string &markup = plan->wordMarkup[l.wordBegin + w];
+      if (!markup.empty()) {
+        continue;
+      }
+      const LyricsWord &word = words[w];
+      markup = escapeMarkup(text.substr(0, word.textOffset)) + "<u>" +
+               escapeMarkup(text.substr(word.textOffset, word.textLength)) +
+               "</u>" +
+               escapeMarkup(text.substr(word.textOffset + word.textLength)) +
+               subMarkup;
     }
   }
-  DEBUG("  >> getSyncedLine: index=%ld, len:%ld , line:[%s]", index, len, index >= len ? "out of size": strVec[index].c_str());
-  if (index >= len) {
-    return "";
-  }
-  auto str = strVec[index];
-  const size_t time_len = 10; // 时间戳长度，例如 "[00:00.00]xxxx"
-  if (str.size() <= time_len) {
-    return "";
+  return plan;
+}
+
+// 播放状态对应的 CSS class
+static const char *statusClass(PlaybackStatus status) {
+  switch (status) {
+  case PlaybackStatus::Playing:
+    return "playing";
+  case PlaybackStatus::Paused:
+    return "paused";
+  default:
+    return "stopped";
   }
-  str = str.substr(time_len, str.size());
-  return trim(str);
 }
-// 定义结构体包装三个参数
+
+// 定义结构体包装更新参数（显示内容在主线程中按下标从 RenderPlan 读取）
 struct UpdateData {
   GtkLabel *label;
-  std::string text;
-  std::string status;
+  std::shared_ptr<const RenderPlan> plan; // 当前歌曲的显示内容
+  size_t line;                            // 当前行
+  size_t word;                            // 当前字（逐字高亮）
+  PlaybackStatus status;
 };
-static void updateLabelText(GtkLabel *label, const std::string &text,
-                            uint64_t position, std::string prefix = "",
-                            const std::string &playerStatus = "playing") {
-  static std::string lastText = ""; // 记录上一次的歌词行
-  auto line = getSyncedLine(position, text);
-
-  line = prefix + line;
-  if (line.empty() || lastText == line) { // 减少不必要的更新
-    DEBUG("  >> No lyrics or same line, skipping update: [%s]", line.c_str());
+
+// 在主线程中设置标签文本：逐字歌词使用 Pango 标记给当前正在唱的字加下划线
+static void applyLabelText(const UpdateData &data) {
+  const RenderPlan &plan = *data.plan;
+  // 暂停/停止时以状态代替歌曲信息作为前缀
+  const char *statusPrefix = data.status == PlaybackStatus::Playing ? nullptr
+                             : data.status == PlaybackStatus::Paused
+                                 ? "paused..."
+                                 : "stopped...";
+  if (data.word == LyricsDocument::npos) {
+    std::string text = statusPrefix ? statusPrefix : plan.prefix;
+    if (data.line < plan.lines.size()) {
+      text.append(plan.lines[data.line]);
+    }
+    gtk_label_set_text(data.label, text.c_str());
     return;
   }
-  lastText = line;
-  DEBUG("  >> Updating label: positon:%ld, text: %s", position, line.c_str());
+  const size_t index = plan.lyrics->line(data.line).wordBegin + data.word;
+  std::string markup = statusPrefix ? statusPrefix : plan.prefixMarkup;
+  markup.append(plan.wordMarkup[index]);
+  gtk_label_set_markup(data.label, markup.c_str());
+}
+
+// 提交到主线程更新标签（只在行、字或状态变化时调用）
+static void updateLabelText(GtkLabel *label,
+                            const std::shared_ptr<const RenderPlan> &plan,
+                            size_t line, size_t word, PlaybackStatus status) {
+  DEBUG("  >> Updating label: line: %zu, word: %zu", line, word);
   // 使用 gdk_threads_add_idle 提交到主线程执行
   gdk_threads_add_idle(
       [](gpointer data) -> gboolean {
@@ -222,7 +728,7 @@ static void updateLabelText(GtkLabel *label, const std::string &text,
     // 检查标签是否存活
     if (GTK_IS_LABEL(updateData->label)) {
       // 设置标签文本
-      gtk_label_set_text(updateData->label, updateData->text.c_str());
+      applyLabelText(*updateData);
       // 添加播放状态对应的 CSS class（如 "playing" 或 "paused"）
       auto context =
           gtk_widget_get_style_context(GTK_WIDGET(updateData->label));
@@ -230,12 +736,12 @@ static void updateLabelText(GtkLabel *label, const std::string &text,
       for (const auto &class_name : {"playing", "paused", "stopped"}) {
         gtk_style_context_remove_class(context, class_name);
       }
-      gtk_style_context_add_class(context, updateData->status.c_str());
+      gtk_style_context_add_class(context, statusClass(updateData->status));
     }
 
     delete updateData; // 释放动态分配的内存
     return FALSE;
-    }, new UpdateData{label, line, playerStatus}  // 传递结构体实例
+    }, new UpdateData{label, plan, line, word, status}  // 传递结构体实例
   );
 }
 
@@ -247,40 +753,45 @@ void WayLyrics::start(GtkLabel *label) {
 
   INFO("  >> Starting update thread");
   updateThread_ = std::thread([this]() {
+    std::shared_ptr<const RenderPlan> plan; // 当前歌曲的显示内容
+    LyricsCursor cursor;                    // 时间轴行游标
+    // 上一次提交的显示状态，行号/字号/状态都相同时跳过更新
+    const RenderPlan *lastPlan = nullptr;
+    size_t lastLine = LyricsDocument::npos, lastWord = LyricsDocument::npos;
+    PlaybackStatus lastStatus = PlaybackStatus::Unknown;
     while (isRunning_) {
       DEBUG("  >> Update thread started");
-      std::string prefix = "";
-      std::string lyricsLine = "";
-      std::string playerStatus = "playing";
       try {
-        if (!currentState_.metadata.title.empty()) {
-          prefix = "《" + currentState_.metadata.title + "》" +
-                    currentState_.metadata.artist + " - ";
-        } else {
-          prefix = "[no title]" + currentState_.metadata.artist + " - ";
+        // 每次刷新只计算行号和字号，显示文本已在 RenderPlan 中准备好，不分配内存
+        std::unique_lock<std::mutex> lock(stateMutex_);
+        if (plan != renderPlan_) {
+          plan = renderPlan_;
+          cursor.reset(); // 切换歌曲后游标失效
         }
-        if (currentState_.status == PlaybackStatus::Playing) {
-          playerStatus = "playing";
-          if (currentState_.metadata.lyrics.empty()) {
-            lyricsLine = "no lyrics...";
-          } else {
-            lyricsLine = currentState_.metadata.lyrics;
-          }
-        } else if(currentState_.status == PlaybackStatus::Paused) {
-          playerStatus = "paused";
-          prefix = "paused...";
-        } else {
-          playerStatus = "stopped";
-          prefix = "stopped...";
+        const PlaybackStatus status = currentState_.status;
+        uint64_t position = currentState_.position;
+        lock.unlock();
+        size_t line = LyricsDocument::npos, word = LyricsDocument::npos;
+        if (plan && plan->lyrics) {
+          line = plan->lyrics->lineAt(position, cursor);
+          word = plan->lyrics->wordAt(line, position, cursor);
+        }
+        if (plan && (plan.get() != lastPlan || line != lastLine ||
+                     word != lastWord || status != lastStatus)) {
+          lastPlan = plan.get();
+          lastLine = line;
+          lastWord = word;
+          lastStatus = status;
+          updateLabelText(displayLabel_, plan, line, word, status);
         }
-        updateLabelText(displayLabel_, currentState_.metadata.lyrics,
-                      currentState_.position, prefix, playerStatus);
         // 短间隔睡眠并检查 isRunning_，减少退出延迟
         for (unsigned int i = 0; i < updateInterval_ && isRunning_; ++i) {
           std::this_thread::sleep_for(std::chrono::seconds(1));
+          lock.lock();
           if (isRunning_ && currentState_.status == PlaybackStatus::Playing) {
             currentState_.position += 1000;
           }
+          lock.unlock();
         }
       } catch (const std::exception &e) {
         WARN("  >> Update thread error: %s", e.what());
@@ -1,6 +1,7 @@
 #include "../include/way_lyrics.h"
 #include "../include/waybar_cffi_module.h"
 #include "common.h"
+#include <cctype>
 #include <gtk/gtk.h>
 #include <memory>
 #include <sdbus-c++/sdbus-c++.h>
@@ -25,50 +26,90 @@ struct Mod {
 // 全局实例计数（用于调试）
 static int instance_count = 0;
 
+// 解析歌词来源列表：逗号分隔的字符串（"player,cache,lrclib"）或 JSON 数组
+// （waybar 把数组序列化为 JSON 文本传入），名称以外的字符都视为分隔符
+static std::vector<std::string> parseProviders(const char *value) {
+  std::vector<std::string> names;
+  std::string name;
+  for (const char *p = value;; ++p) {
+    if (*p && (isalnum(static_cast<unsigned char>(*p)) || *p == '_')) {
+      name += static_cast<char>(tolower(static_cast<unsigned char>(*p)));
+      continue;
+    }
+    if (!name.empty()) {
+      names.push_back(std::move(name));
+      name.clear();
+    }
+    if (!*p) {
+      return names;
+    }
+  }
+}
+
 // 配置解析辅助函数（从waybar配置中提取参数）
-static std::tuple<std::string, std::string, std::string, int, std::string>
-parseConfig(const wbcffi_config_entry *config_entries,
-            size_t config_entries_len) {
-  std::string cssClass = defaultCssClass;
-  std::string labelId = defaultLabelId;
-  std::string destName = defaultDestName;
-  int updateInterval = defaultUpdateInterval;
-  std::string cacheDir = std::string(getenv("HOME")) + "/.cache/waylyrics";
+static WayLyricsConfig parseConfig(const wbcffi_config_entry *config_entries,
+                                   size_t config_entries_len) {
+  WayLyricsConfig config;
+  config.cssClass = defaultCssClass;
+  config.labelId = defaultLabelId;
+  config.destName = defaultDestName;
+  config.updateInterval = defaultUpdateInterval;
+  config.cacheDir = std::string(getenv("HOME")) + "/.cache/waylyrics";
   for (size_t i = 0; i < config_entries_len; ++i) {
     const auto &entry = config_entries[i];
     if (strncmp(entry.key, "class", 5) == 0) {
-      cssClass = entry.value;
+      config.cssClass = entry.value;
     } else if (strncmp(entry.key, "id", 2) == 0) {
-      labelId = entry.value;
+      config.labelId = entry.value;
     } else if (strncmp(entry.key, "dest", 4) == 0) {
-      destName = entry.value;
+      config.destName = entry.value;
     } else if (strncmp(entry.key, "interval", 8) == 0) {
-      updateInterval = std::max(1, atoi(entry.value)); // 最小间隔1秒
+      config.updateInterval = std::max(1, atoi(entry.value)); // 最小间隔1秒
     } else if (strncmp(entry.key, "cache_dir", 10) == 0) {
-      cacheDir = entry.value;
+      config.cacheDir = entry.value;
+    } else if (strncmp(entry.key, "cache_memory_kb", 16) == 0) {
+      config.cacheMemoryKb = std::max(0, atoi(entry.value));
+    } else if (strncmp(entry.key, "cache_max_mb", 13) == 0) {
+      config.cacheMaxMb = std::max(0, atoi(entry.value));
+    } else if (strncmp(entry.key, "cache_refresh_days", 19) == 0) {
+      config.cacheRefreshDays = std::max(0, atoi(entry.value));
+    } else if (strncmp(entry.key, "cache_sync", 11) == 0) {
+      config.cacheSync = strcmp(entry.value, "true") == 0 ||
+                         strcmp(entry.value, "1") == 0;
+    } else if (strncmp(entry.key, "lrclib_url", 11) == 0) {
+      config.lrclibUrl = entry.value;
+    } else if (strncmp(entry.key, "netease_url", 12) == 0) {
+      config.neteaseUrl = entry.value;
+    } else if (strncmp(entry.key, "providers", 10) == 0) {
+      config.providers = parseProviders(entry.value);
+    } else if (strncmp(entry.key, "translation", 12) == 0) {
+      config.showTranslation = strcmp(entry.value, "false") != 0 &&
+                               strcmp(entry.value, "0") != 0;
     } else {
       DEBUG("waylyrics: 未知配置项 '%s'", entry.key);
     }
   }
-  if (cssClass.empty()) {
-    cssClass = defaultCssClass;
+  if (config.cssClass.empty()) {
+    config.cssClass = defaultCssClass;
   }
-  if (labelId.empty()) {
-    labelId = defaultLabelId;
+  if (config.labelId.empty()) {
+    config.labelId = defaultLabelId;
   }
-  if (destName.empty()) {
-    destName = defaultDestName;
+  if (config.destName.empty()) {
+    config.destName = defaultDestName;
   }
-  if (updateInterval <= 0) {
-    updateInterval = defaultUpdateInterval;
+  if (config.updateInterval <= 0) {
+    config.updateInterval = defaultUpdateInterval;
   }
-  if (cacheDir.empty()) {
-    cacheDir = std::string(getenv("HOME")) + "/.cache/waylyrics";
+  if (config.cacheDir.empty()) {
+    config.cacheDir = std::string(getenv("HOME")) + "/.cache/waylyrics";
   }
-  DEBUG("waylyrics: 配置解析完成，参数: class=%s, id=%s, dest=%s, interval=%d, cache_dir=%s",
-        cssClass.c_str(), labelId.c_str(), destName.c_str(), updateInterval, 
-        cacheDir.c_str());
-  return {cssClass, labelId, destName, updateInterval, cacheDir};
+  DEBUG("waylyrics: 配置解析完成，参数: class=%s, id=%s, dest=%s, interval=%d, cache_dir=%s, translation=%d, cache_memory_kb=%zu, cache_max_mb=%zu, cache_refresh_days=%d, cache_sync=%d",
+        config.cssClass.c_str(), config.labelId.c_str(), config.destName.c_str(),
+        config.updateInterval, config.cacheDir.c_str(), config.showTranslation,
+        config.cacheMemoryKb, config.cacheMaxMb, config.cacheRefreshDays,
+        config.cacheSync);
+  return config;
 }
 
 // waybar插件初始化入口（waybar要求的固定接口）
@@ -79,8 +120,7 @@ void *wbcffi_init(const wbcffi_init_info *init_info,
     INFO("waylyrics: 初始化插件，配置项数量: %ld", config_entries_len);
 
     // 解析配置参数
-    auto [cssClass, labelId, destName, updateInterval, cacheDir] =
-        parseConfig(config_entries, config_entries_len);
+    auto config = parseConfig(config_entries, config_entries_len);
 
     // 创建插件实例结构体
     Mod *inst = (Mod *)malloc(sizeof(Mod));
@@ -93,7 +133,7 @@ void *wbcffi_init(const wbcffi_init_info *init_info,
     inst->waybar_module = init_info->obj;
     inst->wayLyrics = nullptr;
     try{
-      inst->wayLyrics = std::make_unique<WayLyrics>(cacheDir, updateInterval, cssClass);
+      inst->wayLyrics = std::make_unique<WayLyrics>(config);
     } catch (const std::exception &e) {
       ERROR("waylyrics: 初始化失败，std::exception: %s", e.what());
     } catch (...) {
@@ -111,8 +151,8 @@ void *wbcffi_init(const wbcffi_init_info *init_info,
     GtkLabel *label = GTK_LABEL(gtk_label_new(loadingText));
     GtkStyleContext *label_context =
         gtk_widget_get_style_context(GTK_WIDGET(label));
-    gtk_style_context_add_class(label_context, cssClass.c_str()); // 应用CSS类
-    gtk_widget_set_name(GTK_WIDGET(label), labelId.c_str());      // 设置标签ID
+    gtk_style_context_add_class(label_context, config.cssClass.c_str()); // 应用CSS类
+    gtk_widget_set_name(GTK_WIDGET(label), config.labelId.c_str());      // 设置标签ID
     gtk_container_add(GTK_CONTAINER(inst->container), GTK_WIDGET(label));
 
     inst->wayLyrics->start(label); // 启动歌词显示
@@ -154,6 +194,8 @@ void wbcffi_doaction(void *instance, const char *action_name) {
   /*} else if(action == "stop"){
     inst->wayLyrics->playerManager_->stopPlayer();
   */
+  } else if (action == "stats") {
+    inst->wayLyrics->logStats(); // 输出歌词缓存统计
   } else if (action == "shuffle") {
     inst->wayLyrics->playerManager_->setShuffle(!inst->wayLyrics->playerManager_->isShuffle());
   // }else if(action == "toggleLabel") {